@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "cpu.hpp"
+#include "programs.hpp"
+
+namespace
+{
+    struct OpcodeCase
+    {
+        const char* name;
+        uint16_t word;
+        int index_reg;
+    };
+
+    // One representative word per opcode, V0 and V1 start at zero
+    constexpr std::array<OpcodeCase, 31> OPCODES {{
+        {"00E0_clearScreen", 0x00E0, 0x000},
+        {"00EE_returnFromSubroutine", 0x00EE, 0x000},
+        {"1NNN_setProgramCounter", 0x1200, 0x000},
+        {"2NNN_callSubroutine", 0x2200, 0x000},
+        {"3XNN_skipIfEqual", 0x3000, 0x000},
+        {"4XNN_skipIfNotEqual", 0x4000, 0x000},
+        {"5XY0_skipIfRegistersEqual", 0x5010, 0x000},
+        {"6XNN_setRegister", 0x6012, 0x000},
+        {"7XNN_addToRegister", 0x7001, 0x000},
+        {"8XY0_assignment", 0x8010, 0x000},
+        {"8XY1_OR", 0x8011, 0x000},
+        {"8XY2_AND", 0x8012, 0x000},
+        {"8XY3_XOR", 0x8013, 0x000},
+        {"8XY4_addWithCarry", 0x8014, 0x000},
+        {"8XY5_subtract", 0x8015, 0x000},
+        {"8XY6_shiftRight", 0x8016, 0x000},
+        {"8XYE_shiftLeft", 0x801E, 0x000},
+        {"9XY0_skipIfRegistersNotEqual", 0x9010, 0x000},
+        {"ANNN_setIndexRegister", 0xA300, 0x000},
+        {"BNNN_jumpWithOffset", 0xB200, 0x000},
+        {"CXNN_random", 0xC0FF, 0x000},
+        {"DXYN_drawOnDisplay", 0xD015, 0x050},
+        {"EX9E_skipIfKeyPressed", 0xE09E, 0x000},
+        {"EXA1_skipIfKeyNotPressed", 0xE0A1, 0x000},
+        {"FX07_assignDelayTimer", 0xF007, 0x000},
+        {"FX0A_waitForKey", 0xF00A, 0x000},
+        {"FX15_setDelayTimer", 0xF015, 0x000},
+        {"FX18_setSoundTimer", 0xF018, 0x000},
+        {"FX33_storeBCD", 0xF033, 0x300},
+        {"FX55_storeRegisters", 0xF555, 0x300},
+        {"FX65_loadRegisters", 0xF565, 0x300}
+    }};
+
+    // Fetches and executes the same instruction at 0x200 over and over
+    void BM_Opcode(benchmark::State& state, OpcodeCase opcode)
+    {
+        Memory memory;
+        memory.loadProgram(std::vector<uint8_t>{static_cast<uint8_t>(opcode.word >> 8), static_cast<uint8_t>(opcode.word)});
+        CosmacCPU cpu {&memory};
+
+        for (auto _ : state)
+        {
+            cpu.program_counter = memory::PROGRAM_OFFSET;
+            cpu.index_reg = opcode.index_reg;
+            cpu.fetch();
+            cpu.decode();
+            benchmark::DoNotOptimize(cpu.gp_regs);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    const bool registered = []
+    {
+        for (const OpcodeCase& opcode : OPCODES)
+        {
+            benchmark::RegisterBenchmark((std::string{"BM_Opcode/"} + opcode.name).c_str(), BM_Opcode, opcode);
+        }
+        return true;
+    }();
+
+    // Decoding alone, a single lookup in the opcode table
+    void BM_Classify(benchmark::State& state)
+    {
+        uint16_t word {};
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(opcode::TABLE[word++]);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_Classify);
+
+    constexpr int DISPATCH_SLICE {10'000};
+
+    // Instructions/s through the interpreter, one fetch and decode call per instruction as before
+    // the opcode table, against execute()'s batched loop, built with or without CHIP8_THREADED_DISPATCH
+    template <typename Program>
+    void BM_Dispatch(benchmark::State& state, Program program, bool batched)
+    {
+        Memory memory;
+        memory.loadProgram(program);
+        CosmacCPU cpu {&memory};
+        cpu.skip_idle_loops = false;
+
+        for (auto _ : state)
+        {
+            if (batched)
+            {
+                cpu.execute(DISPATCH_SLICE);
+                continue;
+            }
+
+            for (int i {0}; i < DISPATCH_SLICE; ++i)
+            {
+                cpu.fetch();
+                cpu.decode();
+            }
+        }
+
+        state.counters["instructions/s"] = benchmark::Counter(static_cast<double>(state.iterations()) * DISPATCH_SLICE, benchmark::Counter::kIsRate);
+    }
+
+    template <typename Program>
+    void registerDispatch(const std::string& name, const Program& program)
+    {
+        benchmark::RegisterBenchmark(("BM_Dispatch/step/" + name).c_str(), BM_Dispatch<Program>, program, false);
+        benchmark::RegisterBenchmark(("BM_Dispatch/execute/" + name).c_str(), BM_Dispatch<Program>, program, true);
+    }
+
+    const bool dispatch_registered = []
+    {
+        for (const auto& entry : std::filesystem::directory_iterator{CHIP8_EXAMPLE_PROGRAMS})
+        {
+            if (entry.path().extension() == ".ch8")
+                registerDispatch(entry.path().stem().string(), entry.path().string());
+        }
+
+        registerDispatch("synthetic_alu_loop", programs::ALU_LOOP);
+        registerDispatch("synthetic_draw_loop", programs::DRAW_LOOP);
+        return true;
+    }();
+}
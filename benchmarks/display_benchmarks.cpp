@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "cpu.hpp"
+
+namespace
+{
+    void BM_DisplayClear(benchmark::State& state)
+    {
+        Display display;
+        for (auto _ : state)
+        {
+            display.drawSpriteRow(0, 0, 0xFF);
+            display.clear();
+            benchmark::DoNotOptimize(display.rows());
+        }
+    }
+    BENCHMARK(BM_DisplayClear);
+
+    // A single sprite row, aligned at x = 0 and clipped at x = 60
+    void BM_DisplayDrawSpriteRow(benchmark::State& state)
+    {
+        Display display;
+        const int x {static_cast<int>(state.range(0))};
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(display.drawSpriteRow(x, 7, 0xA5));
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_DisplayDrawSpriteRow)->Arg(0)->Arg(13)->Arg(60);
+
+    // Full DXYN, sprite height given by the argument
+    void BM_DrawOnDisplay(benchmark::State& state)
+    {
+        const int height {static_cast<int>(state.range(0))};
+
+        Memory memory;
+        memory.loadProgram(std::vector<uint8_t>{0xD0, static_cast<uint8_t>(0x10 | height)});
+        CosmacCPU cpu {&memory};
+        cpu.gp_regs[0] = 13;
+        cpu.gp_regs[1] = 20;
+
+        for (auto _ : state)
+        {
+            cpu.program_counter = memory::PROGRAM_OFFSET;
+            cpu.index_reg = 0x050;
+            cpu.fetch();
+            cpu.decode();
+            benchmark::DoNotOptimize(cpu.gp_regs[0xF]);
+        }
+
+        state.SetItemsProcessed(state.iterations() * height);
+    }
+    BENCHMARK(BM_DrawOnDisplay)->Arg(1)->Arg(5)->Arg(15);
+
+    void BM_MemoryLoadProgram(benchmark::State& state)
+    {
+        const std::vector<uint8_t> program(memory::SIZE - memory::PROGRAM_OFFSET, 0x12);
+        Memory memory;
+
+        for (auto _ : state)
+        {
+            memory.loadProgram(program);
+            benchmark::DoNotOptimize(memory.data());
+        }
+
+        state.SetBytesProcessed(state.iterations() * program.size());
+    }
+    BENCHMARK(BM_MemoryLoadProgram);
+
+    void BM_MemoryLoadProgramFromFile(benchmark::State& state)
+    {
+        const std::string path {std::string{CHIP8_EXAMPLE_PROGRAMS} + "/IBM Logo.ch8"};
+        Memory memory;
+
+        for (auto _ : state)
+        {
+            memory.loadProgram(path);
+            benchmark::DoNotOptimize(memory.data());
+        }
+    }
+    BENCHMARK(BM_MemoryLoadProgramFromFile);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Synthetic ROMs that keep a single part of the core busy
+namespace programs
+{
+    // Tight loop over the ALU and FX opcodes
+    inline const std::vector<uint8_t> ALU_LOOP {
+        0x60, 0x01, // 6001 V0 = 1
+        0x61, 0x02, // 6102 V1 = 2
+        0x80, 0x14, // 8014 V0 += V1
+        0x80, 0x12, // 8012 V0 &= V1
+        0x80, 0x13, // 8013 V0 ^= V1
+        0x80, 0x15, // 8015 V0 -= V1
+        0x80, 0x1E, // 801E V0 = V1 << 1
+        0x80, 0x16, // 8016 V0 = V1 >> 1
+        0xF0, 0x18, // F018 sound timer = V0
+        0xF0, 0x07, // F007 V0 = delay timer
+        0xA3, 0x00, // A300 I = 0x300
+        0x12, 0x00  // 1200 jump to 0x200
+    };
+
+    // Sprite drawing across the whole screen, including rows clipped at the right edge
+    inline const std::vector<uint8_t> DRAW_LOOP {
+        0xA0, 0x50, // A050 I = font '0'
+        0xD0, 0x15, // D015 draw 5 rows at V0, V1
+        0x70, 0x03, // 7003 V0 += 3
+        0x71, 0x05, // 7105 V1 += 5
+        0x12, 0x02  // 1202 jump to 0x202
+    };
+
+    // Nested subroutine calls with memory stores, the block cache's worst case
+    inline const std::vector<uint8_t> CALL_LOOP {
+        0x22, 0x06, // 2206 call 0x206
+        0x70, 0x01, // 7001 V0 += 1
+        0x12, 0x00, // 1200 jump to 0x200
+        0xA3, 0x00, // A300 I = 0x300
+        0xF0, 0x33, // F033 store BCD of V0
+        0x00, 0xEE  // 00EE return
+    };
+}
@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "cpu.hpp"
+#include "programs.hpp"
+
+namespace
+{
+    constexpr int SLICE {10'000};
+
+    // Whole-program throughput, counters report instructions per second and the predecode hit rate
+    template <typename Program>
+    void BM_Rom(benchmark::State& state, Program program, Backend backend)
+    {
+        Memory memory;
+        memory.loadProgram(program);
+        CosmacCPU cpu {&memory};
+        cpu.backend = backend;
+
+        // Measures the dispatch loop itself, a ROM that ends in a jump-to-self would otherwise cost nothing
+        cpu.skip_idle_loops = false;
+
+        for (auto _ : state)
+        {
+            cpu.execute(SLICE);
+        }
+
+        state.counters["instructions/s"] = benchmark::Counter(static_cast<double>(state.iterations()) * SLICE, benchmark::Counter::kIsRate);
+        state.counters["predecode_hit_rate"] = memory.predecodeHitRate();
+    }
+
+    // Frames including the timer tick, as the front ends run them
+    template <typename Program>
+    void BM_RomFrames(benchmark::State& state, Program program)
+    {
+        Memory memory;
+        memory.loadProgram(program);
+        CosmacCPU cpu {&memory};
+
+        for (auto _ : state)
+        {
+            cpu.runFrame(timer::CYCLES_PER_FRAME);
+        }
+
+        state.counters["frames/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    }
+
+    template <typename Program>
+    void registerRom(const std::string& name, const Program& program)
+    {
+        benchmark::RegisterBenchmark(("BM_Rom/interpreter/" + name).c_str(), BM_Rom<Program>, program, Backend::interpreter);
+        benchmark::RegisterBenchmark(("BM_Rom/blockCache/" + name).c_str(), BM_Rom<Program>, program, Backend::blockCache);
+        benchmark::RegisterBenchmark(("BM_RomFrames/" + name).c_str(), BM_RomFrames<Program>, program);
+    }
+
+    const bool registered = []
+    {
+        for (const auto& entry : std::filesystem::directory_iterator{CHIP8_EXAMPLE_PROGRAMS})
+        {
+            if (entry.path().extension() == ".ch8")
+                registerRom(entry.path().stem().string(), entry.path().string());
+        }
+
+        registerRom("synthetic_alu_loop", programs::ALU_LOOP);
+        registerRom("synthetic_draw_loop", programs::DRAW_LOOP);
+        registerRom("synthetic_call_loop", programs::CALL_LOOP);
+        return true;
+    }();
+}
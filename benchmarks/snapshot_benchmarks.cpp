@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "cpu.hpp"
+#include "rewind.hpp"
+#include "programs.hpp"
+
+namespace
+{
+    struct Machine
+    {
+        Memory memory;
+        CosmacCPU cpu {&memory};
+        MachineState state {};
+
+        Machine() noexcept
+        {
+            memory.loadProgram(programs::DRAW_LOOP);
+            cpu.runFrame(1000);
+            cpu.saveState(state);
+        }
+
+        [[nodiscard]] int64_t stateBytes() const noexcept
+        {
+            return static_cast<int64_t>(sizeof(CpuState) + sizeof(Framebuffer) + state.ram_size);
+        }
+    };
+
+    void BM_SnapshotCapture(benchmark::State& state)
+    {
+        const auto machine {std::make_unique<Machine>()};
+        for (auto _ : state)
+        {
+            machine->cpu.saveState(machine->state);
+            benchmark::DoNotOptimize(machine->state);
+        }
+
+        state.SetBytesProcessed(state.iterations() * machine->stateBytes());
+    }
+    BENCHMARK(BM_SnapshotCapture);
+
+    void BM_SnapshotRestore(benchmark::State& state)
+    {
+        const auto machine {std::make_unique<Machine>()};
+        for (auto _ : state)
+        {
+            machine->cpu.loadState(machine->state);
+        }
+
+        state.SetBytesProcessed(state.iterations() * machine->stateBytes());
+    }
+    BENCHMARK(BM_SnapshotRestore);
+
+    void BM_SnapshotCopy(benchmark::State& state)
+    {
+        const auto machine {std::make_unique<Machine>()};
+        const auto copy {std::make_unique<MachineState>()};
+        for (auto _ : state)
+        {
+            *copy = machine->state;
+            benchmark::DoNotOptimize(*copy);
+        }
+
+        state.SetBytesProcessed(state.iterations() * machine->stateBytes());
+    }
+    BENCHMARK(BM_SnapshotCopy);
+
+    void BM_SnapshotFile(benchmark::State& state)
+    {
+        const auto machine {std::make_unique<Machine>()};
+        const std::string path {"benchmark_snapshot.c8ss"};
+
+        for (auto _ : state)
+        {
+            saveSnapshot(path, machine->state);
+            loadSnapshot(path, machine->state);
+        }
+
+        std::remove(path.c_str());
+    }
+    BENCHMARK(BM_SnapshotFile);
+
+    // One frame of emulation plus its push into the rewind buffer
+    void BM_RewindPush(benchmark::State& state)
+    {
+        const auto machine {std::make_unique<Machine>()};
+        const auto buffer {std::make_unique<RewindBuffer>()};
+        uint64_t frame {};
+
+        for (auto _ : state)
+        {
+            machine->cpu.runFrame(timer::CYCLES_PER_FRAME);
+            machine->cpu.saveState(machine->state);
+            buffer->push(frame++, machine->state);
+        }
+
+        state.counters["bytes/frame"] = buffer->bytesPerFrame();
+    }
+    BENCHMARK(BM_RewindPush);
+}
@@ -0,0 +1,70 @@
+#include "aot.hpp"
+#include <algorithm>
+#include <cstring>
+
+bool aot::unchanged(const Memory& memory, std::span<const uint8_t> rom, int first, int last) noexcept
+{
+    const int rom_end {memory::PROGRAM_OFFSET + static_cast<int>(rom.size())};
+    first = std::max(first, memory::PROGRAM_OFFSET);
+    last = std::min({last, rom_end, memory.size()});
+    if (first >= last)
+        return true;
+
+    return std::memcmp(memory.data().data() + first, rom.data() + (first - memory::PROGRAM_OFFSET), static_cast<std::size_t>(last - first)) == 0;
+}
+
+AotRunner::AotRunner(CPU* cpu, const Memory* memory, const AotProgram& program) noexcept :
+    cpu {cpu},
+    memory {memory},
+    program {&program},
+    entries(static_cast<std::size_t>(memory->size()), nullptr),
+    page_generations(program.blocks.size())
+{
+    for (std::size_t i{0}; i < program.blocks.size(); ++i)
+    {
+        const AotBlock& block {program.blocks[i]};
+        const int first_page {block.start / memory::PAGE_SIZE};
+
+        // A ROM recompiled for a larger address space than this profile's leaves its upper blocks to the interpreter
+        if (block.start < memory->size())
+            entries[block.start] = &block;
+        page_generations[i] = {memory->pageGeneration(first_page), memory->pageGeneration(first_page + 1)};
+    }
+}
+
+bool AotRunner::isCurrent(std::size_t index) noexcept
+{
+    const AotBlock& block {program->blocks[index]};
+    const int first_page {block.start / memory::PAGE_SIZE};
+    std::array<uint32_t, 2>& generations {page_generations[index]};
+
+    if (generations[0] == memory->pageGeneration(first_page) && generations[1] == memory->pageGeneration(first_page + 1))
+        return true;
+
+    // A write landed on the block's pages, often data sharing a page with code, so look at the bytes themselves
+    if (!aot::unchanged(*memory, program->rom, block.start, block.end + 2))
+        return false;
+
+    generations = {memory->pageGeneration(first_page), memory->pageGeneration(first_page + 1)};
+    return true;
+}
+
+void AotRunner::execute(int cycles) noexcept
+{
+    while (cycles > 0)
+    {
+        const AotBlock* block {entries[cpu->program_counter & memory->addressMask()]};
+
+        if (block && block->length <= cycles && isCurrent(static_cast<std::size_t>(block - program->blocks.data())))
+        {
+            const int executed {block->run(*cpu, *memory)};
+            cycles -= executed;
+            compiled += static_cast<uint64_t>(executed);
+            continue;
+        }
+
+        cpu->execute(1);
+        cycles--;
+        interpreted++;
+    }
+}
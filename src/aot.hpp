@@ -0,0 +1,60 @@
+#pragma once
+#include "cpu.hpp"
+#include <span>
+#include <vector>
+
+// Runs one recompiled basic block and returns how many instructions it executed,
+// fewer than its length when a store rewrote the rest of the block
+using aot_block_t = int (*)(CPU& cpu, const Memory& memory) noexcept;
+
+// Native code for the instructions in [start, end), valid while the ROM bytes up to end + 2 are unchanged.
+// The two bytes past the end decide how far a trailing skip jumps
+struct AotBlock
+{
+    uint16_t start {};
+    uint16_t end {};
+    uint16_t length {};
+    aot_block_t run {nullptr};
+};
+
+// What chip8-recompile emits for one ROM
+struct AotProgram
+{
+    std::span<const uint8_t> rom {};
+    std::span<const AotBlock> blocks {};
+};
+
+// Defined by the recompiled translation unit linked into the native executable
+[[nodiscard]] const AotProgram& aotProgram() noexcept;
+
+namespace aot
+{
+    // True while memory still holds the ROM's bytes for [first, last)
+    [[nodiscard]] bool unchanged(const Memory& memory, std::span<const uint8_t> rom, int first, int last) noexcept;
+}
+
+// Runs recompiled blocks where the program counter lands on one and the interpreter everywhere else:
+// indirect BNNN targets, code the recompiler never reached and code that has been rewritten.
+// A block only runs when it fits in the remaining cycles, so timers see exactly what the interpreter would
+class AotRunner
+{
+private:
+    CPU* cpu;
+    const Memory* memory;
+    const AotProgram* program;
+    std::vector<const AotBlock*> entries;
+    std::vector<std::array<uint32_t, 2>> page_generations;
+    uint64_t compiled {};
+    uint64_t interpreted {};
+
+    [[nodiscard]] bool isCurrent(std::size_t block) noexcept;
+
+public:
+    AotRunner(CPU* cpu, const Memory* memory, const AotProgram& program) noexcept;
+
+    // A drop-in for CPU::execute
+    void execute(int cycles) noexcept;
+
+    [[nodiscard]] uint64_t compiledInstructions() const noexcept { return compiled; }
+    [[nodiscard]] uint64_t interpretedInstructions() const noexcept { return interpreted; }
+};
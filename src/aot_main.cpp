@@ -0,0 +1,109 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <vector>
+#include "aot.hpp"
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: <recompiled binary> [--frames N] [--cycles-per-frame N] [--seed N]\n"
+                  << "                           [--profile cosmac|chip48|superchip|xochip] [--verify]\n"
+                  << "       --verify runs the interpreter alongside and stops at the first frame that differs\n";
+    }
+
+    bool sameMachine(const CPU& first, const CPU& second, const Memory& first_memory, const Memory& second_memory) noexcept
+    {
+        return first.gp_regs == second.gp_regs && first.program_counter == second.program_counter
+            && first.index_reg == second.index_reg && first.cpu_stack == second.cpu_stack
+            && first.delay_timer == second.delay_timer && first.sound_timer == second.sound_timer
+            && first.display.state() == second.display.state() && first_memory.data() == second_memory.data();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    long long frames {600};
+    int cycles_per_frame {timer::CYCLES_PER_FRAME};
+    uint32_t seed {};
+    Profile profile {Profile::cosmac};
+    bool verify {false};
+
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string arg {argv[i]};
+        const bool has_value {i + 1 < argc};
+
+        if (arg == "--frames" && has_value)
+            frames = std::stoll(argv[++i]);
+        else if (arg == "--cycles-per-frame" && has_value)
+            cycles_per_frame = std::stoi(argv[++i]);
+        else if (arg == "--seed" && has_value)
+            seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--profile" && has_value && parseProfile(argv[i + 1], profile))
+            ++i;
+        else if (arg == "--verify")
+            verify = true;
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if (cycles_per_frame <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    const AotProgram& program {aotProgram()};
+    const std::vector<uint8_t> rom {program.rom.begin(), program.rom.end()};
+
+    Memory memory {memorySize(profile)};
+    memory.loadProgram(rom);
+    const auto cpu {makeCPU(profile, &memory)};
+    cpu->seed(seed);
+    AotRunner runner {cpu.get(), &memory, program};
+
+    Memory reference_memory {memorySize(profile)};
+    reference_memory.loadProgram(rom);
+    const auto reference {makeCPU(profile, &reference_memory)};
+    reference->seed(seed);
+
+    const auto start {std::chrono::steady_clock::now()};
+
+    for (long long frame{0}; frame < frames; ++frame)
+    {
+        runner.execute(cycles_per_frame);
+        cpu->endFrame();
+
+        if (!verify)
+            continue;
+
+        reference->runFrame(cycles_per_frame);
+        if (!sameMachine(*cpu, *reference, memory, reference_memory))
+        {
+            std::cout << "Recompiled code diverged from the interpreter in frame " << frame
+                      << ", pc 0x" << std::hex << cpu->program_counter << " vs 0x" << reference->program_counter << std::dec << '\n';
+            return 1;
+        }
+    }
+
+    const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+    const uint64_t executed {runner.compiledInstructions() + runner.interpretedInstructions()};
+    const double seconds {std::max(elapsed.count(), 1e-9)};
+
+    std::cout << "instructions:        " << executed << '\n'
+              << "compiled:            " << runner.compiledInstructions() << '\n'
+              << "interpreted:         " << runner.interpretedInstructions() << '\n'
+              << "frames:              " << frames << '\n'
+              << "elapsed:             " << elapsed.count() << " s\n"
+              << "instructions/sec:    " << executed / seconds << '\n';
+
+    if (verify)
+        std::cout << "matches the interpreter for every frame\n";
+
+    return 0;
+}
@@ -0,0 +1,261 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <thread>
+#include "cpu.hpp"
+#include "hash.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace
+{
+    struct Job
+    {
+        std::string bin_path {};
+        uint32_t seed {};
+        long long cycles {};
+    };
+
+    struct Result
+    {
+        uint64_t state_hash {};
+        long long cycles {};
+        double wall_time_ms {};
+        // Empty when the job ran, the rest of the result is then meaningless
+        std::string error {};
+    };
+
+    void printUsage()
+    {
+        std::cout << "Usage: chip8-batch <manifest> <results.csv|results.json> [--threads N] [--block-cache]\n"
+                  << "                   [--profile cosmac|chip48|superchip|xochip]\n"
+                  << "Manifest lines: <binary file> <seed> <cycles>, quote paths with spaces, '#' starts a comment\n";
+    }
+
+    bool readManifest(const std::string& path, std::vector<Job>& jobs)
+    {
+        std::ifstream ifs {path};
+        if (!ifs)
+            return false;
+
+        std::string line {};
+        int line_number {0};
+        while (std::getline(ifs, line))
+        {
+            line_number++;
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+
+            std::istringstream fields {line};
+            Job job {};
+            if (!(fields >> std::quoted(job.bin_path) >> job.seed >> job.cycles))
+            {
+                std::cout << path << ':' << line_number << ": expected <binary file> <seed> <cycles>\n";
+                return false;
+            }
+
+            jobs.push_back(job);
+        }
+
+        return true;
+    }
+
+    uint64_t hashState(const CPU& cpu, const Memory& memory) noexcept
+    {
+        uint64_t hash {hash::fnv1a(cpu.gp_regs.data(), cpu.gp_regs.size())};
+        hash = hash::fnv1a(static_cast<uint64_t>(cpu.program_counter), hash);
+        hash = hash::fnv1a(static_cast<uint64_t>(cpu.index_reg), hash);
+        hash = hash::fnv1a(memory.data().data(), memory.data().size(), hash);
+
+        for (const display_plane_t& plane : cpu.display.rows())
+        {
+            for (const display_row_t& row : plane)
+            {
+                hash = hash::fnv1a(row[0], hash);
+                hash = hash::fnv1a(row[1], hash);
+            }
+        }
+
+        return hash;
+    }
+
+    Result runJob(const Job& job, Backend backend, Profile profile)
+    {
+        const auto start {std::chrono::steady_clock::now()};
+
+        auto memory {std::make_unique<Memory>(memorySize(profile))};
+        if (!memory->loadProgram(job.bin_path))
+            return {0, 0, 0.0, "could not read " + job.bin_path};
+
+        const auto cpu {makeCPU(profile, memory.get())};
+        cpu->backend = backend;
+        cpu->seed(job.seed);
+
+        long long remaining {job.cycles};
+        while (remaining >= timer::CYCLES_PER_FRAME)
+        {
+            cpu->runFrame(timer::CYCLES_PER_FRAME);
+            remaining -= timer::CYCLES_PER_FRAME;
+        }
+        cpu->execute(static_cast<int>(remaining));
+
+        const std::chrono::duration<double, std::milli> elapsed {std::chrono::steady_clock::now() - start};
+        return {hashState(*cpu, *memory), job.cycles, elapsed.count()};
+    }
+
+    std::string hex(uint64_t value)
+    {
+        std::ostringstream oss {};
+        oss << "0x" << std::hex << std::setw(16) << std::setfill('0') << value;
+        return oss.str();
+    }
+
+    // RFC 4180, a field with a comma, quote or line break is quoted and its quotes doubled
+    std::string csvEscape(const std::string& text)
+    {
+        if (text.find_first_of(",\"\r\n") == std::string::npos)
+            return text;
+
+        std::string escaped {"\""};
+        for (const char c : text)
+        {
+            if (c == '"')
+                escaped += '"';
+            escaped += c;
+        }
+        return escaped + '"';
+    }
+
+    std::string jsonEscape(const std::string& text)
+    {
+        std::string escaped {};
+        for (const char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    void writeResults(std::ostream& os, bool json, const std::vector<Job>& jobs, const std::vector<Result>& results)
+    {
+        if (!json)
+            os << "rom,seed,cycles,state_hash,wall_time_ms,error\n";
+        else
+            os << "[\n";
+
+        for (std::size_t i{0}; i < jobs.size(); ++i)
+        {
+            const Job& job {jobs[i]};
+            const Result& result {results[i]};
+
+            // A failed job keeps its row, with the error in place of the hash
+            if (!json && !result.error.empty())
+            {
+                os << csvEscape(job.bin_path) << ',' << job.seed << ",,,," << csvEscape(result.error) << '\n';
+            }
+            else if (!json)
+            {
+                os << csvEscape(job.bin_path) << ',' << job.seed << ',' << result.cycles << ','
+                   << hex(result.state_hash) << ',' << result.wall_time_ms << ",\n";
+            }
+            else if (!result.error.empty())
+            {
+                os << "  {\"rom\": \"" << jsonEscape(job.bin_path) << "\", \"seed\": " << job.seed
+                   << ", \"error\": \"" << jsonEscape(result.error) << "\"}"
+                   << (i + 1 < jobs.size() ? ",\n" : "\n");
+            }
+            else
+            {
+                os << "  {\"rom\": \"" << jsonEscape(job.bin_path) << "\", \"seed\": " << job.seed
+                   << ", \"cycles\": " << result.cycles << ", \"state_hash\": \"" << hex(result.state_hash)
+                   << "\", \"wall_time_ms\": " << result.wall_time_ms << '}'
+                   << (i + 1 < jobs.size() ? ",\n" : "\n");
+            }
+        }
+
+        if (json)
+            os << "]\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> paths {};
+    unsigned threads {std::thread::hardware_concurrency()};
+    Backend backend {Backend::interpreter};
+    Profile profile {Profile::cosmac};
+
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string arg {argv[i]};
+
+        if (arg == "--threads" && i + 1 < argc)
+            threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        else if (arg == "--block-cache")
+            backend = Backend::blockCache;
+        else if (arg == "--profile" && i + 1 < argc)
+        {
+            if (!parseProfile(argv[++i], profile))
+            {
+                printUsage();
+                return -1;
+            }
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.size() != 2)
+    {
+        printUsage();
+        return -1;
+    }
+
+    std::vector<Job> jobs {};
+    if (!readManifest(paths[0], jobs))
+    {
+        std::cout << "Could not read manifest " << paths[0] << '\n';
+        return -1;
+    }
+
+    std::vector<Result> results(jobs.size());
+    WorkStealingPool pool {threads};
+
+    for (std::size_t i{0}; i < jobs.size(); ++i)
+    {
+        pool.submit([&jobs, &results, backend, profile, i]
+        {
+            results[i] = runJob(jobs[i], backend, profile);
+        });
+    }
+
+    const auto start {std::chrono::steady_clock::now()};
+    pool.run();
+    const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+    std::ofstream ofs {paths[1]};
+    const bool json {paths[1].size() >= 5 && paths[1].compare(paths[1].size() - 5, 5, ".json") == 0};
+    writeResults(ofs, json, jobs, results);
+
+    std::cout << jobs.size() << " jobs on " << pool.workerCount() << " workers in " << elapsed.count()
+              << " s (" << pool.stealCount() << " steals)\n";
+
+    int failed {0};
+    for (std::size_t i{0}; i < jobs.size(); ++i)
+    {
+        if (results[i].error.empty())
+            continue;
+
+        std::cout << "Job " << i + 1 << " failed: " << results[i].error << '\n';
+        failed++;
+    }
+
+    return failed == 0 ? 0 : 1;
+}
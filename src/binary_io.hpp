@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Fixed little-endian layout so files move between hosts
+namespace binary_io
+{
+    template <typename T>
+    void write(std::ostream& os, T value)
+    {
+        for (std::size_t i{0}; i < sizeof(T); ++i)
+        {
+            os.put(static_cast<char>((static_cast<uint64_t>(value) >> (i * 8)) & 0xFF));
+        }
+    }
+
+    template <typename T>
+    bool read(std::istream& is, T& value)
+    {
+        uint64_t result {0};
+        for (std::size_t i{0}; i < sizeof(T); ++i)
+        {
+            const int byte {is.get()};
+            if (byte == std::char_traits<char>::eof())
+                return false;
+
+            result |= static_cast<uint64_t>(byte) << (i * 8);
+        }
+
+        value = static_cast<T>(result);
+        return true;
+    }
+
+    // Every file starts with its format's magic number and version
+    inline void writeHeader(std::ostream& os, uint32_t magic, uint16_t version)
+    {
+        write(os, magic);
+        write(os, version);
+    }
+
+    // False unless the file starts with exactly this magic number and version
+    inline bool readHeader(std::istream& is, uint32_t magic, uint16_t version)
+    {
+        uint32_t file_magic {};
+        uint16_t file_version {};
+        return read(is, file_magic) && file_magic == magic && read(is, file_version) && file_version == version;
+    }
+}
@@ -0,0 +1,79 @@
+#include "block_cache.hpp"
+#include <algorithm>
+
+void BlockCache::translate(Block& block, int start) noexcept
+{
+    block.start = start;
+    block.instructions.clear();
+    block.writes_memory = false;
+
+    int address {start};
+    while (static_cast<int>(block.instructions.size()) < block::MAX_INSTRUCTIONS)
+    {
+        const DecodedInstruction& decoded {memory->fetch(address)};
+        block.instructions.push_back(decoded);
+        block.writes_memory |= opcode::writesMemory(decoded.op);
+        address += 2;
+
+        if (opcode::isControlFlow(decoded.op))
+            break;
+    }
+
+    block.end = address;
+    block.length = static_cast<int>(block.instructions.size());
+    block.first_page = start / memory::PAGE_SIZE;
+    block.last_page = (address - 1) / memory::PAGE_SIZE;
+    block.page_generations = {memory->pageGeneration(block.first_page), memory->pageGeneration(block.last_page)};
+    block.checked_writes = memory->writeCount();
+    translations++;
+}
+
+Block& BlockCache::chain(Block& from, int address) noexcept
+{
+    auto& successors {from.successors};
+    auto found {std::find_if(successors.begin(), successors.end(), [address](const Block* block)
+    {
+        return block && block->start == address;
+    })};
+
+    Block* next {};
+    if (found != successors.end() && revalidate(**found))
+        next = *found;
+    else
+    {
+        next = &lookup(address);
+        // Retranslated in place, so a stale entry already points at the same block
+        if (found == successors.end())
+            found = successors.end() - 1;
+    }
+
+    // Moved to the front, the least recently followed successor drops off the end
+    std::rotate(successors.begin(), found, found + 1);
+    successors[0] = next;
+    return *next;
+}
+
+BlockCache::BlockCache(Memory* memory) noexcept
+    : memory{memory},
+      blocks(static_cast<std::size_t>(memory->size()))
+{
+}
+
+Block& BlockCache::lookup(int address) noexcept
+{
+    address &= memory->addressMask();
+    auto& block {blocks[address]};
+
+    if (!block)
+    {
+        block = std::make_unique<Block>();
+        translate(*block, address);
+    }
+    else if (!revalidate(*block))
+    {
+        // Retranslated in place so chained pointers to it stay usable
+        translate(*block, address);
+    }
+
+    return *block;
+}
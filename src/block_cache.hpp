@@ -0,0 +1,78 @@
+#pragma once
+#include "memory.hpp"
+#include <memory>
+#include <vector>
+
+namespace block
+{
+    // Keeps every block within two consecutive memory pages
+    constexpr int MAX_INSTRUCTIONS {64};
+    // Successors remembered per block, enough for a subroutine returning to a few call sites
+    constexpr int SUCCESSORS {4};
+}
+
+// Straight-line run of predecoded instructions ending at the first control flow instruction
+struct Block
+{
+    int start {};
+    int end {};
+    // Pages holding the block's own bytes, a store to any other page leaves it current
+    int first_page {};
+    int last_page {};
+    std::vector<DecodedInstruction> instructions {};
+    int length {};
+    std::array<uint32_t, 2> page_generations {};
+    // Memory::writeCount() when the block was last found current, unchanged means nothing can have gone stale
+    uint64_t checked_writes {};
+    bool writes_memory {false};
+
+    // Chained successors, most recently followed first, matched against the program counter before being followed
+    std::array<Block*, block::SUCCESSORS> successors {};
+};
+
+class BlockCache
+{
+private:
+    Memory* memory;
+    // One slot per address, as large as the memory
+    std::vector<std::unique_ptr<Block>> blocks;
+    uint64_t translations {};
+
+    void translate(Block& block, int start) noexcept;
+    [[nodiscard]] Block& chain(Block& from, int address) noexcept;
+
+public:
+    explicit BlockCache(Memory* memory) noexcept;
+
+    [[nodiscard]] Block& lookup(int address) noexcept;
+    [[nodiscard]] uint64_t translationCount() const noexcept { return translations; }
+
+    [[nodiscard]] bool isCurrent(const Block& block) const noexcept
+    {
+        return block.page_generations[0] == memory->pageGeneration(block.first_page) &&
+               block.page_generations[1] == memory->pageGeneration(block.last_page);
+    }
+
+    // isCurrent, with a yes remembered until memory is next written
+    [[nodiscard]] bool revalidate(Block& block) noexcept
+    {
+        const uint64_t writes {memory->writeCount()};
+        if (block.checked_writes == writes)
+            return true;
+        if (!isCurrent(block))
+            return false;
+
+        block.checked_writes = writes;
+        return true;
+    }
+
+    // Block to run after from when the program counter is address, the common case costs no lookup
+    [[nodiscard]] Block& follow(Block& from, int address) noexcept
+    {
+        Block* next {from.successors[0]};
+        if (next && next->start == address && revalidate(*next)) [[likely]]
+            return *next;
+
+        return chain(from, address);
+    }
+};
@@ -0,0 +1,79 @@
+#include "call_graph.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+CallGraphSampler::CallGraphSampler(const Memory* memory, int interval) noexcept :
+    memory {memory},
+    interval {std::max(interval, 1)},
+    until_sample {this->interval}
+{
+}
+
+uint16_t CallGraphSampler::subroutineEntry(int return_address) const noexcept
+{
+    // The 2NNN that pushed a return address sits just before it
+    const int high {memory->getByte(return_address - 2)};
+    const int low {memory->getByte(return_address - 1)};
+
+    if ((high >> 4) != 0x2)
+        return 0;
+
+    return static_cast<uint16_t>(((high & 0x0F) << 8) | low);
+}
+
+void CallGraphSampler::execute(CPU& cpu, int cycles) noexcept
+{
+    while (cycles > 0)
+    {
+        const int chunk {std::min(cycles, until_sample)};
+        cpu.execute(chunk);
+        cycles -= chunk;
+        until_sample -= chunk;
+
+        if (until_sample == 0)
+        {
+            sample(cpu);
+            until_sample = interval;
+        }
+    }
+}
+
+void CallGraphSampler::sample(const CPU& cpu) noexcept
+{
+    scratch.clear();
+    for (std::size_t depth{0}; depth < cpu.cpu_stack.size(); ++depth)
+    {
+        scratch.push_back(subroutineEntry(cpu.cpu_stack.entries[depth]));
+    }
+
+    stacks[scratch]++;
+    samples++;
+}
+
+void CallGraphSampler::writeFolded(std::ostream& out) const
+{
+    out << std::hex << std::uppercase << std::setfill('0');
+
+    for (const auto& [stack, count] : stacks)
+    {
+        out << "main";
+        for (const uint16_t entry : stack)
+        {
+            if (entry == 0)
+                out << ";sub_unknown";
+            else
+                out << ";sub_0x" << std::setw(3) << entry;
+        }
+        out << ' ' << std::dec << count << std::hex << '\n';
+    }
+
+    out << std::dec;
+}
+
+bool CallGraphSampler::writeFolded(const std::string& path) const noexcept
+{
+    std::ofstream ofs {path};
+    writeFolded(ofs);
+    return ofs.good();
+}
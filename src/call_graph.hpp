@@ -0,0 +1,38 @@
+#pragma once
+#include "cpu.hpp"
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace call_graph
+{
+    constexpr int DEFAULT_INTERVAL {97}; // prime, so samples do not lock step with short loops
+}
+
+// Samples the guest call stack every N instructions and aggregates it into folded stacks for flamegraph.pl
+class CallGraphSampler
+{
+private:
+    const Memory* memory;
+    int interval;
+    int until_sample;
+    uint64_t samples {};
+    std::map<std::vector<uint16_t>, uint64_t> stacks {};
+    std::vector<uint16_t> scratch {};
+
+    [[nodiscard]] uint16_t subroutineEntry(int return_address) const noexcept;
+
+public:
+    CallGraphSampler(const Memory* memory, int interval = call_graph::DEFAULT_INTERVAL) noexcept;
+
+    // Runs the CPU in chunks that end on sample points, a drop-in for CPU::execute
+    void execute(CPU& cpu, int cycles) noexcept;
+    void sample(const CPU& cpu) noexcept;
+
+    [[nodiscard]] uint64_t sampleCount() const noexcept { return samples; }
+
+    // One "main;sub_0x2A0;sub_0x31C count" line per distinct stack
+    void writeFolded(std::ostream& out) const;
+    bool writeFolded(const std::string& path) const noexcept;
+};
@@ -0,0 +1,383 @@
+#include "capture.hpp"
+#include "binary_io.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <string_view>
+
+namespace
+{
+    // How long the writer sleeps when the queue was empty
+    constexpr std::chrono::microseconds WRITER_IDLE {500};
+
+    constexpr std::size_t WORD_BYTES {sizeof(display_word_t)};
+    constexpr std::size_t FRAME_BYTES {display::PLANES * display::HIRES_HEIGHT * display::WORDS_PER_ROW * WORD_BYTES};
+
+    using frame_bytes_t = std::array<uint8_t, FRAME_BYTES>;
+
+    constexpr std::string_view Y4M_HEADER {"YUV4MPEG2 W128 H64 F60:1 Ip A1:1 C444\n"};
+    constexpr std::string_view Y4M_FRAME {"FRAME\n"};
+    constexpr std::size_t PLANE_BYTES {capture::WIDTH * capture::HEIGHT};
+
+    struct YCbCr
+    {
+        uint8_t y;
+        uint8_t cb;
+        uint8_t cr;
+    };
+
+    // BT.601 limited range, what ffmpeg assumes for 4:4:4 Y4M
+    constexpr YCbCr toYCbCr(uint32_t rgba) noexcept
+    {
+        const int r {static_cast<int>((rgba >> 24) & 0xFF)};
+        const int g {static_cast<int>((rgba >> 16) & 0xFF)};
+        const int b {static_cast<int>((rgba >> 8) & 0xFF)};
+
+        return {static_cast<uint8_t>(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8)),
+                static_cast<uint8_t>(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8)),
+                static_cast<uint8_t>(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8))};
+    }
+
+    constexpr std::array<YCbCr, 4> Y4M_PALETTE {
+        toYCbCr(display::PALETTE[0]), toYCbCr(display::PALETTE[1]), toYCbCr(display::PALETTE[2]), toYCbCr(display::PALETTE[3])
+    };
+
+    frame_bytes_t toBytes(const Framebuffer& framebuffer) noexcept
+    {
+        frame_bytes_t bytes {};
+        std::size_t offset {0};
+
+        for (const display_plane_t& plane : framebuffer.planes)
+        {
+            for (const display_row_t& row : plane)
+            {
+                for (const display_word_t word : row)
+                {
+                    for (std::size_t i{0}; i < WORD_BYTES; ++i)
+                    {
+                        bytes[offset++] = static_cast<uint8_t>(word >> (i * 8));
+                    }
+                }
+            }
+        }
+
+        return bytes;
+    }
+
+    void fromBytes(const frame_bytes_t& bytes, Framebuffer& framebuffer) noexcept
+    {
+        std::size_t offset {0};
+
+        for (display_plane_t& plane : framebuffer.planes)
+        {
+            for (display_row_t& row : plane)
+            {
+                for (display_word_t& word : row)
+                {
+                    word = 0;
+                    for (std::size_t i{0}; i < WORD_BYTES; ++i)
+                    {
+                        word |= static_cast<display_word_t>(bytes[offset++]) << (i * 8);
+                    }
+                }
+            }
+        }
+    }
+
+    void writeCount(std::vector<uint8_t>& out, std::size_t count) noexcept
+    {
+        do
+        {
+            const uint8_t low {static_cast<uint8_t>(count & 0x7F)};
+            count >>= 7;
+            out.push_back(count ? (low | 0x80) : low);
+        } while (count);
+    }
+
+    bool readCount(const std::vector<uint8_t>& in, std::size_t& position, std::size_t& count) noexcept
+    {
+        count = 0;
+        for (int shift{0}; position < in.size() && shift < 32; shift += 7)
+        {
+            const uint8_t byte {in[position++]};
+            count |= static_cast<std::size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    // Runs of (zero bytes, literal bytes) over the XOR of two frames, unchanged bytes past the last literal are implied
+    void encodeDelta(const frame_bytes_t& previous, const frame_bytes_t& current, std::vector<uint8_t>& out) noexcept
+    {
+        out.clear();
+        std::size_t position {0};
+
+        while (position < FRAME_BYTES)
+        {
+            const std::size_t run_start {position};
+            while (position < FRAME_BYTES && previous[position] == current[position])
+                position++;
+            if (position == FRAME_BYTES)
+                break;
+
+            const std::size_t literal_start {position};
+            while (position < FRAME_BYTES && previous[position] != current[position])
+                position++;
+
+            writeCount(out, literal_start - run_start);
+            writeCount(out, position - literal_start);
+            for (std::size_t i{literal_start}; i < position; ++i)
+            {
+                out.push_back(previous[i] ^ current[i]);
+            }
+        }
+    }
+
+    bool applyDelta(const std::vector<uint8_t>& delta, frame_bytes_t& bytes) noexcept
+    {
+        std::size_t in {0};
+        std::size_t out {0};
+
+        while (in < delta.size())
+        {
+            std::size_t zeros {};
+            std::size_t literals {};
+            if (!readCount(delta, in, zeros) || !readCount(delta, in, literals))
+                return false;
+
+            out += zeros;
+            if (out + literals > FRAME_BYTES || in + literals > delta.size())
+                return false;
+
+            for (std::size_t i{0}; i < literals; ++i)
+            {
+                bytes[out++] ^= delta[in++];
+            }
+        }
+
+        return true;
+    }
+}
+
+bool parseCaptureFormat(const std::string& name, CaptureFormat& format) noexcept
+{
+    if (name == "delta")
+        format = CaptureFormat::delta;
+    else if (name == "y4m")
+        format = CaptureFormat::y4m;
+    else
+        return false;
+    return true;
+}
+
+Y4mWriter::Y4mWriter(std::ofstream& file) noexcept :
+    file {file},
+    image(Y4M_FRAME.size() + 3 * PLANE_BYTES)
+{
+    file.write(Y4M_HEADER.data(), static_cast<std::streamsize>(Y4M_HEADER.size()));
+    std::copy(Y4M_FRAME.begin(), Y4M_FRAME.end(), image.begin());
+
+    // Frames before the first one captured are blank
+    std::fill_n(image.begin() + Y4M_FRAME.size(), PLANE_BYTES, static_cast<char>(Y4M_PALETTE[0].y));
+    std::fill_n(image.begin() + Y4M_FRAME.size() + PLANE_BYTES, PLANE_BYTES, static_cast<char>(Y4M_PALETTE[0].cb));
+    std::fill_n(image.begin() + Y4M_FRAME.size() + 2 * PLANE_BYTES, PLANE_BYTES, static_cast<char>(Y4M_PALETTE[0].cr));
+}
+
+void Y4mWriter::write(uint64_t frame, const Framebuffer& framebuffer) noexcept
+{
+    finish(frame);
+
+    char* const y_plane {image.data() + Y4M_FRAME.size()};
+    const int shift {framebuffer.hires ? 0 : 1};
+
+    for (int y{0}; y < capture::HEIGHT; ++y)
+    {
+        for (int x{0}; x < capture::WIDTH; ++x)
+        {
+            const int source_x {x >> shift};
+            const int source_y {y >> shift};
+            const display_word_t bit {display_word_t{1} << (display::WORD_BITS - 1 - source_x % display::WORD_BITS)};
+
+            int index {0};
+            for (int plane{0}; plane < display::PLANES; ++plane)
+            {
+                if (framebuffer.planes[plane][source_y][source_x / display::WORD_BITS] & bit)
+                    index |= 1 << plane;
+            }
+
+            const std::size_t pixel {static_cast<std::size_t>(y * capture::WIDTH + x)};
+            y_plane[pixel] = static_cast<char>(Y4M_PALETTE[index].y);
+            y_plane[PLANE_BYTES + pixel] = static_cast<char>(Y4M_PALETTE[index].cb);
+            y_plane[2 * PLANE_BYTES + pixel] = static_cast<char>(Y4M_PALETTE[index].cr);
+        }
+    }
+
+    file.write(image.data(), static_cast<std::streamsize>(image.size()));
+    next_frame = frame + 1;
+}
+
+void Y4mWriter::finish(uint64_t frame_count) noexcept
+{
+    for (; next_frame < frame_count; ++next_frame)
+    {
+        file.write(image.data(), static_cast<std::streamsize>(image.size()));
+    }
+}
+
+FrameCapture::FrameCapture(const std::string& path, CaptureFormat format, std::size_t capacity) noexcept :
+    file {path, std::ios::binary},
+    frames {std::make_unique<CapturedFrame[]>(std::bit_ceil(capacity))},
+    mask {std::bit_ceil(capacity) - 1}
+{
+    if (!file)
+        return;
+
+    if (format == CaptureFormat::y4m)
+    {
+        y4m = std::make_unique<Y4mWriter>(file);
+        return;
+    }
+
+    binary_io::write(file, capture::MAGIC);
+    binary_io::write(file, capture::VERSION);
+}
+
+FrameCapture::~FrameCapture()
+{
+    stop();
+}
+
+void FrameCapture::capture(uint64_t frame, const Display& display) noexcept
+{
+    frame_count = frame + 1;
+    if (captured_any && display.generation() == last_generation)
+        return;
+
+    // The generation is left behind, so the change goes out with the first frame that finds room
+    const uint64_t position {tail.load(std::memory_order_relaxed)};
+    if (position - head.load(std::memory_order_acquire) > mask)
+    {
+        dropped++;
+        return;
+    }
+
+    frames[position & mask] = {frame, display.state()};
+    tail.store(position + 1, std::memory_order_release);
+
+    last_generation = display.generation();
+    captured_any = true;
+}
+
+void FrameCapture::writeFrame(const CapturedFrame& captured) noexcept
+{
+    written++;
+
+    if (y4m)
+    {
+        y4m->write(captured.frame, captured.framebuffer);
+        return;
+    }
+
+    encodeDelta(toBytes(previous), toBytes(captured.framebuffer), encoded);
+    previous = captured.framebuffer;
+
+    binary_io::write(file, capture::FRAME);
+    binary_io::write(file, captured.frame);
+    binary_io::write(file, static_cast<uint8_t>(captured.framebuffer.hires));
+    binary_io::write(file, static_cast<uint32_t>(encoded.size()));
+    file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+}
+
+bool FrameCapture::drain() noexcept
+{
+    uint64_t position {head.load(std::memory_order_relaxed)};
+    const uint64_t last {tail.load(std::memory_order_acquire)};
+    if (position == last)
+        return false;
+
+    for (; position != last; ++position)
+    {
+        writeFrame(frames[position & mask]);
+        head.store(position + 1, std::memory_order_release);
+    }
+    return true;
+}
+
+void FrameCapture::writeLoop() noexcept
+{
+    while (running.load(std::memory_order_acquire))
+    {
+        if (!drain())
+            std::this_thread::sleep_for(WRITER_IDLE);
+    }
+
+    // The producer has stopped, the rest of the queue is the tail of the run
+    drain();
+
+    if (y4m)
+        y4m->finish(frame_count);
+    else
+    {
+        binary_io::write(file, capture::END);
+        binary_io::write(file, frame_count);
+    }
+    file.flush();
+}
+
+void FrameCapture::start() noexcept
+{
+    if (!file || running.exchange(true))
+        return;
+
+    writer = std::thread {&FrameCapture::writeLoop, this};
+}
+
+void FrameCapture::stop() noexcept
+{
+    if (!running.exchange(false))
+        return;
+
+    writer.join();
+}
+
+CaptureReader::CaptureReader(const std::string& path) noexcept :
+    file {path, std::ios::binary}
+{
+    uint32_t magic {};
+    uint16_t version {};
+    valid = binary_io::read(file, magic) && magic == capture::MAGIC
+         && binary_io::read(file, version) && version == capture::VERSION;
+}
+
+bool CaptureReader::next(uint64_t& frame, Framebuffer& framebuffer) noexcept
+{
+    uint8_t kind {};
+    if (!valid || ended || !binary_io::read(file, kind))
+        return false;
+
+    if (kind == capture::END)
+    {
+        ended = binary_io::read(file, end_frame);
+        return false;
+    }
+
+    uint8_t hires {};
+    uint32_t size {};
+    if (kind != capture::FRAME || !binary_io::read(file, frame) || !binary_io::read(file, hires) || !binary_io::read(file, size))
+        return false;
+
+    encoded.resize(size);
+    if (!file.read(reinterpret_cast<char*>(encoded.data()), size))
+        return false;
+
+    frame_bytes_t bytes {toBytes(current)};
+    if (!applyDelta(encoded, bytes))
+        return false;
+
+    fromBytes(bytes, current);
+    current.hires = hires != 0;
+    framebuffer = current;
+    return true;
+}
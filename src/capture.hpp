@@ -0,0 +1,137 @@
+#pragma once
+#include "display.hpp"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat
+{
+    delta, // run-length coded changes, chip8-capture turns them into video
+    y4m    // raw 4:4:4 frames ffmpeg reads directly
+};
+
+namespace capture
+{
+    constexpr uint32_t MAGIC {0x56433843}; // "C8CV"
+    constexpr uint16_t VERSION {1};
+
+    // Frames the writer may fall behind by, about 1 MB, before new ones are dropped
+    constexpr std::size_t DEFAULT_CAPACITY {512};
+
+    // Delta file record kinds
+    constexpr uint8_t FRAME {0};
+    constexpr uint8_t END {1};
+
+    // Every frame is written at the high resolution size, low resolution pixels are doubled
+    constexpr int WIDTH {display::HIRES_WIDTH};
+    constexpr int HEIGHT {display::HIRES_HEIGHT};
+}
+
+// A framebuffer that differs from the one before it, and the emulated frame it ended
+struct CapturedFrame
+{
+    uint64_t frame {};
+    Framebuffer framebuffer {};
+};
+
+[[nodiscard]] bool parseCaptureFormat(const std::string& name, CaptureFormat& format) noexcept;
+
+// Writes frames as YUV4MPEG2 at 60 fps, repeating the last one over frames that were not captured
+class Y4mWriter
+{
+private:
+    std::ofstream& file;
+    std::vector<char> image;
+    uint64_t next_frame {};
+
+public:
+    explicit Y4mWriter(std::ofstream& file) noexcept;
+
+    // Holds the previous image up to frame, then shows framebuffer from frame on
+    void write(uint64_t frame, const Framebuffer& framebuffer) noexcept;
+    // Holds the last image up to frame_count, the length of the run
+    void finish(uint64_t frame_count) noexcept;
+
+    [[nodiscard]] uint64_t framesWritten() const noexcept { return next_frame; }
+};
+
+// Taps the display once per emulated frame and writes the changes from a background thread.
+// Only frames whose display changed are queued, and a full queue drops the new frame rather than
+// wait for the writer, so the emulation thread never stalls and memory stays at the queue's size.
+// A dropped change goes out with the next frame that finds room, the previous image is held until then.
+// Delta file: magic and version, then records of (kind, frame, hires, byte count, bytes), where the
+// bytes run-length code the XOR against the previous frame: (zero bytes, literal bytes, literals) runs
+// as LEB128 counts. An END record carries the number of frames in the run
+class FrameCapture
+{
+private:
+    std::ofstream file;
+    std::unique_ptr<CapturedFrame[]> frames;
+    std::size_t mask;
+
+    alignas(64) std::atomic<uint64_t> head {};
+    alignas(64) std::atomic<uint64_t> tail {};
+    alignas(64) uint64_t last_generation {};
+    bool captured_any {false};
+    uint64_t frame_count {};
+    uint64_t dropped {};
+
+    std::atomic<bool> running {false};
+    std::thread writer;
+    Framebuffer previous {};
+    std::vector<uint8_t> encoded;
+    std::unique_ptr<Y4mWriter> y4m;
+    uint64_t written {};
+
+    void writeFrame(const CapturedFrame& captured) noexcept;
+    // Writes every queued frame, returns false when there was none
+    bool drain() noexcept;
+    void writeLoop() noexcept;
+
+public:
+    FrameCapture(const std::string& path, CaptureFormat format, std::size_t capacity = capture::DEFAULT_CAPACITY) noexcept;
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    [[nodiscard]] bool isOpen() const noexcept { return file.is_open(); }
+
+    // Emulation thread, once at the end of every frame
+    void capture(uint64_t frame, const Display& display) noexcept;
+
+    void start() noexcept;
+    // Joins the writer after it has written every queued frame and the end of the run
+    void stop() noexcept;
+
+    // Totals, read them after stop()
+    [[nodiscard]] uint64_t framesWritten() const noexcept { return written; }
+    [[nodiscard]] uint64_t droppedFrames() const noexcept { return dropped; }
+};
+
+// Reads a delta capture back frame by frame
+class CaptureReader
+{
+private:
+    std::ifstream file;
+    bool valid {false};
+    Framebuffer current {};
+    std::vector<uint8_t> encoded;
+    uint64_t end_frame {};
+    bool ended {false};
+
+public:
+    explicit CaptureReader(const std::string& path) noexcept;
+
+    [[nodiscard]] bool isValid() const noexcept { return valid; }
+
+    // The next captured frame, false at the end of the file
+    bool next(uint64_t& frame, Framebuffer& framebuffer) noexcept;
+
+    // Length of the run, known once next() has returned false on a complete file
+    [[nodiscard]] bool isComplete() const noexcept { return ended; }
+    [[nodiscard]] uint64_t frameCount() const noexcept { return end_frame; }
+};
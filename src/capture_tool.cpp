@@ -0,0 +1,56 @@
+#include <iostream>
+#include <string>
+#include "capture.hpp"
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: chip8-capture <delta capture> <output.y4m>\n"
+                  << "       Expands a delta capture into a 60 fps video, e.g. for ffmpeg -i output.y4m output.mp4\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        printUsage();
+        return -1;
+    }
+
+    CaptureReader reader {argv[1]};
+    if (!reader.isValid())
+    {
+        std::cout << "Could not read capture " << argv[1] << '\n';
+        return -1;
+    }
+
+    std::ofstream file {argv[2], std::ios::binary};
+    if (!file)
+    {
+        std::cout << "Could not write video " << argv[2] << '\n';
+        return -1;
+    }
+
+    Y4mWriter video {file};
+    uint64_t frame {};
+    uint64_t changes {0};
+    Framebuffer framebuffer {};
+
+    while (reader.next(frame, framebuffer))
+    {
+        video.write(frame, framebuffer);
+        changes++;
+    }
+
+    // A capture cut short still converts up to its last change
+    if (reader.isComplete())
+        video.finish(reader.frameCount());
+    else
+        std::cout << "Warning: capture ends early, the run was not stopped cleanly\n";
+
+    file.flush();
+    std::cout << video.framesWritten() << " frames, " << changes << " changes\n";
+    return file ? 0 : -1;
+}
@@ -1,67 +1,133 @@
 #include "cpu.hpp"
+#include <algorithm>
 
-std::mutex CPU::delay_timer_mutex;
-std::mutex CPU::sound_timer_mutex;
+void CPU::seed(uint32_t value) noexcept
+{
+    rng.seed(value);
+}
 
-void CPU::processSpriteRow(uint8_t sprite_byte, int x, int y) noexcept
+void CPU::saveState(MachineState& state) const noexcept
 {
-    // Iterating bit by bit from the left to the right
-    for (int j{0}; j < 8; ++j)
-    {
-        // Getting current bit
-        const uint8_t mask = 1 << (7 - j); 
-        const uint8_t current_pixel = (sprite_byte & mask) >> (7 - j);
-        
-        if (current_pixel)
-        {
-            if (display.get(x, y) == Pixel::on)
-            {
-                display.set(x, y, Pixel::off);
-                gp_regs[0xF] = 1;
-            }
-            else
-            {
-                display.set(x, y, Pixel::on);
-            }
-        }
+    state.cpu = *this;
+    state.ram_size = static_cast<uint32_t>(memory->size());
+    std::copy(memory->data().begin(), memory->data().end(), state.ram.begin());
+    state.framebuffer = display.state();
+}
 
-        x++;
-        if (x >= display::WIDTH)
-            break;
-    }
+void CPU::loadState(const MachineState& state) noexcept
+{
+    static_cast<CpuState&>(*this) = state.cpu;
+    memory->restore(state.ram.data(), state.ram_size);
+    display.restore(state.framebuffer);
+
+    // Whatever loop the machine was idling in belongs to the state that was replaced
+    idle_mark_pc = -1;
+    idle_period = 0;
+    idle_keypad = 0;
+    idle_delay_timer = 0;
+    idle_sound_timer = 0;
+}
+
+void CPU::tickTimers() noexcept
+{
+    delay_timer -= (delay_timer > 0);
+    sound_timer -= (sound_timer > 0);
+}
+
+void CPU::unknown() noexcept
+{
+}
+
+void CPU::clearScreen() noexcept
+{
+    display.clear();
+}
+
+void CPU::setProgramCounter() noexcept
+{
+    const int target {(inst.second_nibble << 8) | (inst.third_nibble << 4) | inst.fourth_nibble};
+
+    if (detectsIdleLoops() && target <= program_counter - 2 && program_counter - 2 - target <= idle::MAX_LOOP_BYTES)
+        detectIdleLoop(target);
+
+    program_counter = target;
 }
 
-void CPU::decreaseDelayTimer() noexcept
-{   
-    while (1)
+void CPU::detectIdleLoop(int target) noexcept
+{
+    const int jump {program_counter - 2};
+    if (target == jump)
     {
-        std::lock_guard<std::mutex> guard {CPU::delay_timer_mutex};
-        delay_timer -= (delay_timer > 0);
-        std::cout << "\nDelay: " << static_cast<int>(delay_timer) << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(timer::TIMER_FREQ_IN_MILLISECONDS));
+        elideIdleCycles(1);
+        return;
     }
+
+    // Timers only move between slices, so one unchanged pass through the loop means every later pass is the same
+    const bool repeated {idle_mark_pc == jump && static_cast<const CpuState&>(*this) == idle_mark_state
+                         && memory->writeCount() == idle_mark_writes && display.generation() == idle_mark_generation};
+    if (repeated)
+    {
+        elideIdleCycles(idle_mark_cycles - cycles_left);
+        return;
+    }
+
+    idle_mark_pc = jump;
+    idle_mark_cycles = cycles_left;
+    idle_mark_state = *this;
+    idle_mark_writes = memory->writeCount();
+    idle_mark_generation = display.generation();
 }
 
-void CPU::decreaseSoundTimer() noexcept
+void CPU::elideIdleCycles(int period) noexcept
 {
-    while (1)
-    {
-        std::lock_guard<std::mutex> guard {CPU::sound_timer_mutex};
+    const int skipped {cycles_left / period * period};
+    cycles_left -= skipped;
+    elided_cycles += static_cast<uint64_t>(skipped);
+
+    idle_period = period;
+    idle_keypad = keypad;
+    idle_delay_timer = delay_timer;
+    idle_sound_timer = sound_timer;
+}
 
-        if (sound_timer > 0)
-        {
-            std::cout << '\a';
-            sound_timer -= 1;
-        }
+void CPU::skipHaltedFrames(uint64_t frames, int cycles_per_frame) noexcept
+{
+    const int period {idle_period};
+    const uint64_t cycles {frames * static_cast<uint64_t>(cycles_per_frame)};
+    const int remainder {static_cast<int>(cycles % static_cast<uint64_t>(period))};
+
+    // Whole passes through the loop change nothing, only the partial one has to run
+    execute(remainder);
+    elided_cycles += cycles - static_cast<uint64_t>(remainder);
+    idle_period = period;
+}
 
-        std::cout << "\nSound: " << static_cast<int>(sound_timer) << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(timer::TIMER_FREQ_IN_MILLISECONDS));
-    }
+template <typename Quirks>
+void BasicCPU<Quirks>::skipIfEqual() noexcept
+{
+    if (gp_regs[inst.second_nibble] == ((inst.third_nibble << 4) | inst.fourth_nibble))
+        skipNextInstruction();
 }
 
-void CPU::setProgramCounter() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::skipIfNotEqual() noexcept
 {
-    program_counter = (inst.second_nibble << 8) | (inst.third_nibble << 4) | inst.fourth_nibble;
+    if (gp_regs[inst.second_nibble] != ((inst.third_nibble << 4) | inst.fourth_nibble))
+        skipNextInstruction();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::skipIfRegistersEqual() noexcept
+{
+    if (gp_regs[inst.second_nibble] == gp_regs[inst.third_nibble])
+        skipNextInstruction();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::skipIfRegistersNotEqual() noexcept
+{
+    if (gp_regs[inst.second_nibble] != gp_regs[inst.third_nibble])
+        skipNextInstruction();
 }
 
 void CPU::setRegister() noexcept
@@ -79,21 +145,84 @@ void CPU::setIndexRegister() noexcept
     index_reg = (inst.second_nibble << 8) | (inst.third_nibble << 4) | inst.fourth_nibble;
 }
 
-void CPU::drawOnDisplay() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::drawOnDisplay() noexcept
 {
-    int x = gp_regs[inst.second_nibble] & (display::WIDTH - 1);
-    int y = gp_regs[inst.third_nibble] & (display::HEIGHT - 1);
+    const int x = gp_regs[inst.second_nibble] & (display.width() - 1);
+    const int y = gp_regs[inst.third_nibble] & (display.height() - 1);
     gp_regs[0xF] = 0;
 
-    for (int i{0}; i < inst.fourth_nibble; ++i)
+    // DXY0 draws a 16x16 sprite, two bytes per row, and nothing at all before SUPER-CHIP
+    const bool wide {Quirks::super_chip_instructions && inst.fourth_nibble == 0};
+    const int rows {wide ? 16 : static_cast<int>(inst.fourth_nibble)};
+    const int bytes_per_row {wide ? 2 : 1};
+    const int visible_rows {std::min(rows, display.height() - y)};
+
+    // Each selected plane takes the next sprite in memory
+    int address {index_reg};
+    for (int plane{0}; plane < display::PLANES; ++plane)
     {
-        uint8_t sprite_byte = memory->getByte(index_reg + i);
-        processSpriteRow(sprite_byte, x, y);
+        if (!(display.planeMask() & (1 << plane)))
+            continue;
 
-        y++;
-        if (y >= display::HEIGHT)
-            break;
+        for (int i{0}; i < visible_rows; ++i)
+        {
+            const int row_address {address + i * bytes_per_row};
+            uint16_t sprite {static_cast<uint16_t>(memory->getByte(row_address) << 8)};
+            if (wide)
+                sprite |= memory->getByte(row_address + 1);
+
+            if (display.drawSpriteRow(plane, x, y + i, sprite))
+                gp_regs[0xF] = 1;
+        }
+
+        address += rows * bytes_per_row;
+    }
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::skipNextInstruction() noexcept
+{
+    // F000 NNNN is four bytes long and is skipped whole, elsewhere F000 is an ordinary two-byte word
+    if constexpr (Quirks::xo_chip_instructions)
+    {
+        const bool long_instruction {memory->getByte(program_counter) == 0xF0 && memory->getByte(program_counter + 1) == 0x00};
+        program_counter += long_instruction ? 4 : 2;
+    }
+    else
+        program_counter += 2;
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::skipIfKeyPressed() noexcept
+{
+    if (keypad & (1 << (gp_regs[inst.second_nibble] & 0xF)))
+        skipNextInstruction();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::skipIfKeyNotPressed() noexcept
+{
+    if (!(keypad & (1 << (gp_regs[inst.second_nibble] & 0xF))))
+        skipNextInstruction();
+}
+
+void CPU::waitForKey() noexcept
+{
+    // Re-executed every cycle until a key is held, then stores the lowest one
+    if (keypad == 0)
+    {
+        program_counter -= 2;
+        if (detectsIdleLoops())
+            elideIdleCycles(1);
+        return;
     }
+
+    uint8_t key {0};
+    while (!(keypad & (1 << key)))
+        key++;
+
+    gp_regs[inst.second_nibble] = key;
 }
 
 void CPU::assignment() noexcept
@@ -101,19 +230,28 @@ void CPU::assignment() noexcept
     gp_regs[inst.second_nibble] = gp_regs[inst.third_nibble];
 }
 
-void CPU::OR() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::OR() noexcept
 {
     gp_regs[inst.second_nibble] |= gp_regs[inst.third_nibble];
+    if constexpr (Quirks::logic_resets_vf)
+        gp_regs[0xF] = 0;
 }
 
-void CPU::AND() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::AND() noexcept
 {
     gp_regs[inst.second_nibble] &= gp_regs[inst.third_nibble];
+    if constexpr (Quirks::logic_resets_vf)
+        gp_regs[0xF] = 0;
 }
 
-void CPU::XOR() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::XOR() noexcept
 {
     gp_regs[inst.second_nibble] ^= gp_regs[inst.third_nibble];
+    if constexpr (Quirks::logic_resets_vf)
+        gp_regs[0xF] = 0;
 }
 
 void CPU::addWithCarry() noexcept
@@ -142,159 +280,565 @@ void CPU::returnFromSubroutine() noexcept
     cpu_stack.pop();
 }
 
-void CPU::shiftLeft() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::shiftLeft() noexcept
 {
-    gp_regs[inst.second_nibble] = gp_regs[inst.third_nibble];
+    if constexpr (Quirks::shift_copies_vy)
+        gp_regs[inst.second_nibble] = gp_regs[inst.third_nibble];
+
     int msb {(gp_regs[inst.second_nibble] & 0x80) >> 7};
     gp_regs[inst.second_nibble] <<= 1;
     gp_regs[0xF] = msb ? 1 : 0;
 }
 
-void CPU::shiftRight() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::shiftRight() noexcept
 {
-    gp_regs[inst.second_nibble] = gp_regs[inst.third_nibble];
+    if constexpr (Quirks::shift_copies_vy)
+        gp_regs[inst.second_nibble] = gp_regs[inst.third_nibble];
+
     int lsb {gp_regs[inst.second_nibble] & 0x1};
     gp_regs[inst.second_nibble] >>= 1;
     gp_regs[0xF] = lsb ? 1 : 0;
 }
 
-void CPU::jumpWithOffset() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::jumpWithOffset() noexcept
 {
     program_counter = (inst.second_nibble << 8) | (inst.third_nibble << 4) | inst.fourth_nibble;
-    program_counter += gp_regs[0];
+
+    if constexpr (Quirks::jump_adds_vx)
+        program_counter += gp_regs[inst.second_nibble];
+    else
+        program_counter += gp_regs[0];
 }
 
 void CPU::random() noexcept
 {
-    std::mt19937 mt {std::random_device{}()};
-    std::uniform_int_distribution generate {0, 0xFF}; // generate uint8_t
-    uint8_t generated_number {static_cast<uint8_t>(generate(mt))};
+    uint8_t generated_number {rng.next()};
     generated_number &= ((inst.third_nibble << 4) | inst.fourth_nibble);
     gp_regs[inst.second_nibble] = generated_number;
 }
 
 void CPU::assignDelayTimer() noexcept
 {
-    std::lock_guard<std::mutex> guard {CPU::delay_timer_mutex};
     gp_regs[inst.second_nibble] = delay_timer;
 }
 
 void CPU::setDelayTimer() noexcept
 {
-    std::lock_guard<std::mutex> guard {CPU::delay_timer_mutex};
     delay_timer = gp_regs[inst.second_nibble];
 }
 
 void CPU::setSoundTimer() noexcept
 {
-    std::lock_guard<std::mutex> guard {CPU::sound_timer_mutex};
     sound_timer = gp_regs[inst.second_nibble];
 }
 
-CPU::CPU(Memory* memory) noexcept
-    : memory{memory}
+void CPU::storeBCD() noexcept
 {
+    const uint8_t value {gp_regs[inst.second_nibble]};
+    memory->setByte(index_reg, value / 100);
+    memory->setByte(index_reg + 1, value / 10 % 10);
+    memory->setByte(index_reg + 2, value % 10);
 }
 
-void CPU::fetch() noexcept
+namespace
 {
-    const uint8_t first_byte {memory->getByte(program_counter)};
-    const uint8_t second_byte {memory->getByte(program_counter + 1)};
-    program_counter += 2;
-
-    inst = {first_byte, second_byte};
+    template <typename Quirks>
+    constexpr int indexIncrement(int x) noexcept
+    {
+        switch (Quirks::index_increment)
+        {
+        case IndexIncrement::pastLast: return x + 1;
+        case IndexIncrement::byX: return x;
+        default: return 0;
+        }
+    }
 }
 
-void CPU::decode() noexcept
+template <typename Quirks>
+void BasicCPU<Quirks>::storeRegisters() noexcept
 {
-    if (inst.asWord == 0x00E0)
-    {
-        display.clear();
-    }
-    else if (inst.asWord == 0x00EE)
-    {
-        returnFromSubroutine();
-    }
-    else if (inst.first_nibble == 0x1)
-    {
-        setProgramCounter();
-    }
-    else if (inst.first_nibble == 0x2)
-    {
-        callSubroutine();
-    }
-    else if (inst.first_nibble == 0x6)
-    {
-        setRegister();
-    }
-    else if (inst.first_nibble == 0x7)
-    {
-        addToRegister();
-    }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0x0)
-    {
-        assignment();
-    }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0x1)
+    const int x {static_cast<int>(inst.second_nibble)};
+    for (int i{0}; i <= x; ++i)
     {
-        OR();
+        memory->setByte(index_reg + i, gp_regs[i]);
     }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0x2)
-    {
-        AND();
-    }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0x3)
-    {
-        XOR();
-    }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0x4)
+
+    index_reg += indexIncrement<Quirks>(x);
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::loadRegisters() noexcept
+{
+    const int x {static_cast<int>(inst.second_nibble)};
+    for (int i{0}; i <= x; ++i)
     {
-        addWithCarry();
+        gp_regs[i] = memory->getByte(index_reg + i);
     }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0x5)
+
+    index_reg += indexIncrement<Quirks>(x);
+}
+
+CPU::CPU(Memory* memory) noexcept
+    : memory{memory},
+      predecode{memory->predecodeTable()},
+      address_mask{memory->addressMask()},
+      block_cache{memory}
+{
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::scrollDown() noexcept
+{
+    if constexpr (Quirks::super_chip_instructions)
+        display.scrollDown(inst.fourth_nibble);
+    else
+        unknown();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::scrollUp() noexcept
+{
+    if constexpr (Quirks::xo_chip_instructions)
+        display.scrollUp(inst.fourth_nibble);
+    else
+        unknown();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::scrollRight() noexcept
+{
+    if constexpr (Quirks::super_chip_instructions)
+        display.scrollRight(4);
+    else
+        unknown();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::scrollLeft() noexcept
+{
+    if constexpr (Quirks::super_chip_instructions)
+        display.scrollLeft(4);
+    else
+        unknown();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::lowResolution() noexcept
+{
+    if constexpr (Quirks::super_chip_instructions)
+        display.setHires(false);
+    else
+        unknown();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::highResolution() noexcept
+{
+    if constexpr (Quirks::super_chip_instructions)
+        display.setHires(true);
+    else
+        unknown();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::selectPlanes() noexcept
+{
+    if constexpr (Quirks::xo_chip_instructions)
+        display.selectPlanes(inst.second_nibble);
+    else
+        unknown();
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::loadLongIndex() noexcept
+{
+    if constexpr (Quirks::xo_chip_instructions)
     {
-        subtract();
+        index_reg = (memory->getByte(program_counter) << 8) | memory->getByte(program_counter + 1);
+        program_counter += 2;
     }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0x6)
+    else
+        unknown();
+}
+
+void CPU::fetch() noexcept
+{
+    const DecodedInstruction* decoded {&predecode[program_counter & address_mask]};
+    if (decoded->valid)
+        memory->countPredecodeHit();
+    else
+        decoded = &memory->fetch(program_counter);
+    program_counter += 2;
+
+    inst = decoded->inst;
+    fetched_op = decoded->op;
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::decode() noexcept
+{
+    dispatch(opcode::TABLE[inst.asWord]);
+}
+
+void CPU::recordTrace(int pc, const gp_regs_t& before) noexcept
+{
+    TraceRecord record {};
+    record.pc = static_cast<uint16_t>(pc);
+    record.word = static_cast<uint16_t>(inst.asWord);
+    record.index = static_cast<uint16_t>(index_reg);
+
+    for (int reg{0}; reg < 0xF; ++reg)
     {
-        shiftRight();
+        if (gp_regs[reg] != before[reg])
+        {
+            record.reg = static_cast<uint8_t>(reg);
+            record.value = gp_regs[reg];
+            break;
+        }
     }
-    else if (inst.first_nibble == 0x8 && inst.fourth_nibble == 0xE)
+
+    if (gp_regs[0xF] != before[0xF])
     {
-        shiftLeft();
+        if (record.reg == trace::NO_REGISTER)
+        {
+            record.reg = 0xF;
+            record.value = gp_regs[0xF];
+        }
+        else
+            record.reg |= trace::FLAG_CHANGED;
     }
-    else if (inst.first_nibble == 0xA)
+
+    tracer->push(record);
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::dispatch(Opcode op) noexcept
+{
+    profile.countInstruction(program_counter - 2, op);
+
+    // Tracing wraps the handler so the record can say what it changed
+    if (tracer) [[unlikely]]
     {
-        setIndexRegister();
+        const int pc {program_counter - 2};
+        const gp_regs_t before {gp_regs};
+        handle(op);
+        recordTrace(pc, before);
+        return;
     }
-    else if (inst.first_nibble == 0xB)
+
+    handle(op);
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::handle(Opcode op) noexcept
+{
+
+    switch (op)
     {
-        jumpWithOffset();
+    case Opcode::clearScreen: clearScreen(); break;
+    case Opcode::returnFromSubroutine: returnFromSubroutine(); break;
+    case Opcode::setProgramCounter: setProgramCounter(); break;
+    case Opcode::callSubroutine: callSubroutine(); break;
+    case Opcode::skipIfEqual: skipIfEqual(); break;
+    case Opcode::skipIfNotEqual: skipIfNotEqual(); break;
+    case Opcode::skipIfRegistersEqual: skipIfRegistersEqual(); break;
+    case Opcode::setRegister: setRegister(); break;
+    case Opcode::addToRegister: addToRegister(); break;
+    case Opcode::assignment: assignment(); break;
+    case Opcode::OR: OR(); break;
+    case Opcode::AND: AND(); break;
+    case Opcode::XOR: XOR(); break;
+    case Opcode::addWithCarry: addWithCarry(); break;
+    case Opcode::subtract: subtract(); break;
+    case Opcode::shiftRight: shiftRight(); break;
+    case Opcode::shiftLeft: shiftLeft(); break;
+    case Opcode::skipIfRegistersNotEqual: skipIfRegistersNotEqual(); break;
+    case Opcode::setIndexRegister: setIndexRegister(); break;
+    case Opcode::jumpWithOffset: jumpWithOffset(); break;
+    case Opcode::random: random(); break;
+    case Opcode::drawOnDisplay: drawOnDisplay(); break;
+    case Opcode::skipIfKeyPressed: skipIfKeyPressed(); break;
+    case Opcode::skipIfKeyNotPressed: skipIfKeyNotPressed(); break;
+    case Opcode::waitForKey: waitForKey(); break;
+    case Opcode::assignDelayTimer: assignDelayTimer(); break;
+    case Opcode::setDelayTimer: setDelayTimer(); break;
+    case Opcode::setSoundTimer: setSoundTimer(); break;
+    case Opcode::storeBCD: storeBCD(); break;
+    case Opcode::storeRegisters: storeRegisters(); break;
+    case Opcode::loadRegisters: loadRegisters(); break;
+    case Opcode::scrollDown: scrollDown(); break;
+    case Opcode::scrollUp: scrollUp(); break;
+    case Opcode::scrollRight: scrollRight(); break;
+    case Opcode::scrollLeft: scrollLeft(); break;
+    case Opcode::lowResolution: lowResolution(); break;
+    case Opcode::highResolution: highResolution(); break;
+    case Opcode::selectPlanes: selectPlanes(); break;
+    case Opcode::loadLongIndex: loadLongIndex(); break;
+    default: unknown(); break;
     }
-    else if (inst.first_nibble == 0xC)
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::executeBlocks(int cycles) noexcept
+{
+    Block* block {&block_cache.lookup(program_counter)};
+    cycles_left = cycles;
+
+    // Handlers by Opcode like the threaded labels, a direct call skips handle()'s switch and the spills around it
+    using handler_t = void (BasicCPU::*)() noexcept;
+    static constexpr handler_t handlers[] = {
+        &BasicCPU::unknown,
+        &BasicCPU::clearScreen,
+        &BasicCPU::returnFromSubroutine,
+        &BasicCPU::setProgramCounter,
+        &BasicCPU::callSubroutine,
+        &BasicCPU::skipIfEqual,
+        &BasicCPU::skipIfNotEqual,
+        &BasicCPU::skipIfRegistersEqual,
+        &BasicCPU::setRegister,
+        &BasicCPU::addToRegister,
+        &BasicCPU::assignment,
+        &BasicCPU::OR,
+        &BasicCPU::AND,
+        &BasicCPU::XOR,
+        &BasicCPU::addWithCarry,
+        &BasicCPU::subtract,
+        &BasicCPU::shiftRight,
+        &BasicCPU::shiftLeft,
+        &BasicCPU::skipIfRegistersNotEqual,
+        &BasicCPU::setIndexRegister,
+        &BasicCPU::jumpWithOffset,
+        &BasicCPU::random,
+        &BasicCPU::drawOnDisplay,
+        &BasicCPU::skipIfKeyPressed,
+        &BasicCPU::skipIfKeyNotPressed,
+        &BasicCPU::waitForKey,
+        &BasicCPU::assignDelayTimer,
+        &BasicCPU::setDelayTimer,
+        &BasicCPU::setSoundTimer,
+        &BasicCPU::storeBCD,
+        &BasicCPU::storeRegisters,
+        &BasicCPU::loadRegisters,
+        &BasicCPU::scrollDown,
+        &BasicCPU::scrollUp,
+        &BasicCPU::scrollRight,
+        &BasicCPU::scrollLeft,
+        &BasicCPU::lowResolution,
+        &BasicCPU::highResolution,
+        &BasicCPU::selectPlanes,
+        &BasicCPU::loadLongIndex
+    };
+    static_assert(std::size(handlers) == opcode::COUNT);
+
+    // Traces and profiles are kept per instruction, so those go through dispatch() one step at a time
+    const bool per_instruction {tracer || instrumentation::ENABLED};
+
+    while (cycles_left > 0)
     {
-        random();
+        // Only the last instruction branches, elides cycles or reads the program counter, so both move once per block
+        const DecodedInstruction* const first {block->instructions.data()};
+        const DecodedInstruction* const last {first + std::min(block->length, cycles_left)};
+
+        if (!per_instruction) [[likely]]
+        {
+            const int count {static_cast<int>(last - first)};
+            program_counter += 2 * count;
+            cycles_left -= count;
+        }
+
+        for (const DecodedInstruction* decoded {first}; decoded != last; ++decoded)
+        {
+            inst = decoded->inst;
+
+            if (per_instruction) [[unlikely]]
+            {
+                program_counter += 2;
+                cycles_left--;
+                dispatch(decoded->op);
+            }
+            else
+                (this->*handlers[static_cast<std::size_t>(decoded->op)])();
+
+            // A store may have rewritten the rest of this very block, which is then left unrun
+            if (block->writes_memory && opcode::writesMemory(decoded->op) && !block_cache.revalidate(*block)) [[unlikely]]
+            {
+                if (!per_instruction)
+                {
+                    const int unrun {static_cast<int>(last - decoded) - 1};
+                    program_counter -= 2 * unrun;
+                    cycles_left += unrun;
+                }
+                break;
+            }
+        }
+
+        if (cycles_left <= 0)
+            break;
+
+        block = &block_cache.follow(*block, program_counter);
     }
-    else if (inst.first_nibble == 0xD)
+}
+
+template <typename Quirks>
+void BasicCPU<Quirks>::execute(int cycles) noexcept
+{
+    idle_mark_pc = -1;
+    idle_period = 0;
+
+    if (backend == Backend::blockCache)
     {
-        drawOnDisplay();
+        executeBlocks(cycles);
+        return;
     }
-    else if (inst.first_nibble == 0xF && 
-            inst.third_nibble == 0x0 && 
-            inst.fourth_nibble == 0x7)
+
+#if defined(CHIP8_THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+    // Handlers jump straight to the next one, which leaves no point to trace from
+    if (tracer)
     {
-        assignDelayTimer();
+        for (cycles_left = cycles; cycles_left-- > 0; )
+        {
+            fetch();
+            dispatch(fetched_op);
+        }
+        return;
     }
-    else if (inst.first_nibble == 0xF &&
-            inst.third_nibble == 0x1 &&
-            inst.fourth_nibble == 0x5)
+
+    // Computed-goto dispatch, label order must follow the Opcode enum
+    static void* const labels[] = {
+        &&op_unknown,
+        &&op_clearScreen,
+        &&op_returnFromSubroutine,
+        &&op_setProgramCounter,
+        &&op_callSubroutine,
+        &&op_skipIfEqual,
+        &&op_skipIfNotEqual,
+        &&op_skipIfRegistersEqual,
+        &&op_setRegister,
+        &&op_addToRegister,
+        &&op_assignment,
+        &&op_OR,
+        &&op_AND,
+        &&op_XOR,
+        &&op_addWithCarry,
+        &&op_subtract,
+        &&op_shiftRight,
+        &&op_shiftLeft,
+        &&op_skipIfRegistersNotEqual,
+        &&op_setIndexRegister,
+        &&op_jumpWithOffset,
+        &&op_random,
+        &&op_drawOnDisplay,
+        &&op_skipIfKeyPressed,
+        &&op_skipIfKeyNotPressed,
+        &&op_waitForKey,
+        &&op_assignDelayTimer,
+        &&op_setDelayTimer,
+        &&op_setSoundTimer,
+        &&op_storeBCD,
+        &&op_storeRegisters,
+        &&op_loadRegisters,
+        &&op_scrollDown,
+        &&op_scrollUp,
+        &&op_scrollRight,
+        &&op_scrollLeft,
+        &&op_lowResolution,
+        &&op_highResolution,
+        &&op_selectPlanes,
+        &&op_loadLongIndex
+    };
+    static_assert(std::size(labels) == opcode::COUNT);
+
+#define CHIP8_DISPATCH()                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (cycles_left-- <= 0)                                                 \
+            return;                                                             \
+        fetch();                                                                \
+        profile.countInstruction(program_counter - 2, fetched_op);              \
+        goto *labels[static_cast<std::size_t>(fetched_op)];                     \
+    } while (0)
+
+    cycles_left = cycles;
+    CHIP8_DISPATCH();
+
+op_unknown:                 unknown();              CHIP8_DISPATCH();
+op_clearScreen:             clearScreen();          CHIP8_DISPATCH();
+op_returnFromSubroutine:    returnFromSubroutine(); CHIP8_DISPATCH();
+op_setProgramCounter:       setProgramCounter();    CHIP8_DISPATCH();
+op_callSubroutine:          callSubroutine();       CHIP8_DISPATCH();
+op_skipIfEqual:             skipIfEqual();          CHIP8_DISPATCH();
+op_skipIfNotEqual:          skipIfNotEqual();       CHIP8_DISPATCH();
+op_skipIfRegistersEqual:    skipIfRegistersEqual(); CHIP8_DISPATCH();
+op_setRegister:             setRegister();          CHIP8_DISPATCH();
+op_addToRegister:           addToRegister();        CHIP8_DISPATCH();
+op_assignment:              assignment();           CHIP8_DISPATCH();
+op_OR:                      OR();                   CHIP8_DISPATCH();
+op_AND:                     AND();                  CHIP8_DISPATCH();
+op_XOR:                     XOR();                  CHIP8_DISPATCH();
+op_addWithCarry:            addWithCarry();         CHIP8_DISPATCH();
+op_subtract:                subtract();             CHIP8_DISPATCH();
+op_shiftRight:              shiftRight();           CHIP8_DISPATCH();
+op_shiftLeft:               shiftLeft();            CHIP8_DISPATCH();
+op_skipIfRegistersNotEqual: skipIfRegistersNotEqual(); CHIP8_DISPATCH();
+op_setIndexRegister:        setIndexRegister();     CHIP8_DISPATCH();
+op_jumpWithOffset:          jumpWithOffset();       CHIP8_DISPATCH();
+op_random:                  random();               CHIP8_DISPATCH();
+op_drawOnDisplay:           drawOnDisplay();        CHIP8_DISPATCH();
+op_skipIfKeyPressed:        skipIfKeyPressed();     CHIP8_DISPATCH();
+op_skipIfKeyNotPressed:     skipIfKeyNotPressed();  CHIP8_DISPATCH();
+op_waitForKey:              waitForKey();           CHIP8_DISPATCH();
+op_assignDelayTimer:        assignDelayTimer();     CHIP8_DISPATCH();
+op_setDelayTimer:           setDelayTimer();        CHIP8_DISPATCH();
+op_setSoundTimer:           setSoundTimer();        CHIP8_DISPATCH();
+op_storeBCD:                storeBCD();             CHIP8_DISPATCH();
+op_storeRegisters:          storeRegisters();       CHIP8_DISPATCH();
+op_loadRegisters:           loadRegisters();        CHIP8_DISPATCH();
+op_scrollDown:              scrollDown();           CHIP8_DISPATCH();
+op_scrollUp:                scrollUp();             CHIP8_DISPATCH();
+op_scrollRight:             scrollRight();          CHIP8_DISPATCH();
+op_scrollLeft:              scrollLeft();           CHIP8_DISPATCH();
+op_lowResolution:           lowResolution();        CHIP8_DISPATCH();
+op_highResolution:          highResolution();       CHIP8_DISPATCH();
+op_selectPlanes:            selectPlanes();         CHIP8_DISPATCH();
+op_loadLongIndex:           loadLongIndex();        CHIP8_DISPATCH();
+
+#undef CHIP8_DISPATCH
+#else
+    for (cycles_left = cycles; cycles_left-- > 0; )
     {
-        setDelayTimer();
+        fetch();
+        dispatch(fetched_op);
     }
-    else if (inst.first_nibble == 0xF &&
-            inst.third_nibble == 0x1 &&
-            inst.fourth_nibble == 0x8)
+#endif
+}
+
+void CPU::runFrame(int cycles_per_frame) noexcept
+{
+    execute(cycles_per_frame);
+    endFrame();
+}
+
+void CPU::endFrame() noexcept
+{
+    tickTimers();
+    profile.endFrame();
+}
+
+template class BasicCPU<quirks::Cosmac>;
+template class BasicCPU<quirks::Chip48>;
+template class BasicCPU<quirks::SuperChip>;
+template class BasicCPU<quirks::XoChip>;
+
+std::unique_ptr<CPU> makeCPU(Profile profile, Memory* memory) noexcept
+{
+    switch (profile)
     {
-        setSoundTimer();
+    case Profile::chip48: return std::make_unique<Chip48CPU>(memory);
+    case Profile::superChip: return std::make_unique<SuperChipCPU>(memory);
+    case Profile::xoChip: return std::make_unique<XoChipCPU>(memory);
+    default: return std::make_unique<CosmacCPU>(memory);
     }
 }
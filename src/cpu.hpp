@@ -1,88 +1,190 @@
 #pragma once
 #include "memory.hpp"
 #include "display.hpp"
-#include <iostream>
-#include <stack>
-#include <random>
-#include <mutex>
-#include <thread>
-#include <chrono>
-
-struct Instruction
-{
-    uint32_t first_nibble : 4;
-    uint32_t second_nibble : 4;
-    uint32_t third_nibble : 4;
-    uint32_t fourth_nibble : 4;
-    uint32_t asWord : 16;
-
-    constexpr Instruction() noexcept :
-        first_nibble{},
-        second_nibble{},
-        third_nibble{},
-        fourth_nibble{},
-        asWord{}
-    {
-    }
+#include "opcode.hpp"
+#include "block_cache.hpp"
+#include "machine_state.hpp"
+#include "instrumentation.hpp"
+#include "quirks.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <memory>
 
-    constexpr Instruction(uint8_t first_byte, uint8_t second_byte) noexcept :
-        first_nibble {static_cast<uint32_t>(first_byte & 0xF0) >> 4},
-        second_nibble {static_cast<uint32_t>(first_byte & 0x0F)},
-        third_nibble {static_cast<uint32_t>(second_byte & 0xF0) >> 4},
-        fourth_nibble {static_cast<uint32_t>(second_byte & 0x0F)},
-        asWord {static_cast<uint32_t>((first_byte << 8) | second_byte)}
-    {
-    }
+enum class Backend
+{
+    interpreter,
+    blockCache
 };
 
-using gp_regs_t = std::array<uint8_t, 16>;
-
-class CPU
+// Architectural state lives in the CpuState base so it can be captured in one copy
+class CPU : public CpuState
 {
-private:
+protected:
     Memory* memory;
-    uint8_t delay_timer {10};
-    uint8_t sound_timer {200};
-    static std::mutex delay_timer_mutex;
-    static std::mutex sound_timer_mutex;
-    
-    void processSpriteRow(uint8_t sprite_byte, int x, int y) noexcept;
+    // Memory's predecode table and address mask, a hit costs one load instead of two
+    const DecodedInstruction* predecode;
+    int address_mask;
+    Opcode fetched_op {Opcode::unknown};
+    BlockCache block_cache;
+
+    // Instructions still to run in this execute() once the current one finishes
+    int cycles_left {};
+
+    // Machine as last seen at a short backward jump, a loop that comes back to it unchanged can only repeat
+    int idle_mark_pc {-1};
+    int idle_mark_cycles {};
+    CpuState idle_mark_state {};
+    uint64_t idle_mark_writes {};
+    uint64_t idle_mark_generation {};
+
+    // Length of the loop the last execute() ended in, 0 when it was doing real work
+    int idle_period {};
+    uint16_t idle_keypad {};
+    uint8_t idle_delay_timer {};
+    uint8_t idle_sound_timer {};
+    uint64_t elided_cycles {};
     
-    // Instruction set
+    // Instruction set, the handlers every quirks profile shares
+    void unknown() noexcept;
+    void clearScreen() noexcept;
     void setProgramCounter() noexcept;
     void setRegister() noexcept;
     void addToRegister() noexcept;
     void setIndexRegister() noexcept;
-    void drawOnDisplay() noexcept;
+    void waitForKey() noexcept;
     void assignment() noexcept;
-    void OR() noexcept;
-    void AND() noexcept;
-    void XOR() noexcept;
     void addWithCarry() noexcept;
     void subtract() noexcept;
     void callSubroutine() noexcept;
     void returnFromSubroutine() noexcept;
-    void shiftLeft() noexcept;
-    void shiftRight() noexcept;
-    void jumpWithOffset() noexcept;
     void random() noexcept;
     void assignDelayTimer() noexcept;
     void setDelayTimer() noexcept;
     void setSoundTimer() noexcept;
+    void storeBCD() noexcept;
+
+    [[nodiscard]] bool detectsIdleLoops() const noexcept { return skip_idle_loops && !tracer; }
+
+    // Called by a backward jump to target, before the program counter moves
+    void detectIdleLoop(int target) noexcept;
+
+    // Drops every whole repeat of a period-instruction loop left in this execute()
+    void elideIdleCycles(int period) noexcept;
+
+    // Appends the instruction just executed at pc, before holds the registers from ahead of it
+    void recordTrace(int pc, const gp_regs_t& before) noexcept;
 
 public:
     Display display {};
-    gp_regs_t gp_regs {};
-    int program_counter {memory::PROGRAM_OFFSET};
-    int index_reg {};
     Instruction inst;
-    std::stack<int> cpu_stack {};
+    Backend backend {Backend::interpreter};
+
+    // Empty and free unless built with CHIP8_INSTRUMENTATION
+    [[no_unique_address]] profile_t profile {};
+
+    // Every executed instruction goes to this ring when set, owned by a TraceRecorder
+    TraceBuffer* tracer {nullptr};
+
+    // Loops that provably repeat the same state are skipped up to the end of the slice, off while tracing
+    bool skip_idle_loops {true};
 
     explicit CPU(Memory* memory) noexcept;
+    virtual ~CPU() = default;
+
+    CPU(const CPU&) = delete;
+    CPU& operator=(const CPU&) = delete;
+
+    void seed(uint32_t value) noexcept;
 
-    void decreaseDelayTimer() noexcept;
-    void decreaseSoundTimer() noexcept;
+    void saveState(MachineState& state) const noexcept;
+    void loadState(const MachineState& state) noexcept;
+
+    // Timers count down once per 60 Hz frame, driven by the emulation loop rather than wall time
+    void tickTimers() noexcept;
+    [[nodiscard]] uint8_t delayTimer() const noexcept { return delay_timer; }
+    [[nodiscard]] bool isSoundActive() const noexcept { return sound_timer > 0; }
+
+    // Instructions counted as executed without being run
+    [[nodiscard]] uint64_t elidedCycles() const noexcept { return elided_cycles; }
+
+    // Blocks the block cache backend has translated or retranslated so far
+    [[nodiscard]] uint64_t blockTranslations() const noexcept { return block_cache.translationCount(); }
+
+    // The last slice ended in an idle loop that the timers and the keypad cannot break, so every
+    // following frame repeats it until the host changes the input. The timers are the ones the loop
+    // was elided with, a loop polling a timer that has since ticked to zero must still see it
+    [[nodiscard]] bool isHalted() const noexcept
+    {
+        return idle_period > 0 && idle_delay_timer == 0 && idle_sound_timer == 0 && keypad == idle_keypad;
+    }
+
+    // Runs frames halted frames in the time of a fraction of one, without their timer ticks
+    void skipHaltedFrames(uint64_t frames, int cycles_per_frame) noexcept;
 
     void fetch() noexcept;
-    void decode() noexcept;
+    virtual void decode() noexcept = 0;
+    virtual void execute(int cycles) noexcept = 0;
+
+    // One 60 Hz frame: a slice of instructions followed by a timer tick
+    void runFrame(int cycles_per_frame) noexcept;
+    void endFrame() noexcept;
+};
+
+// Interpreter specialised for one quirks policy, so quirk checks are resolved at compile time
+template <typename Quirks>
+class BasicCPU final : public CPU
+{
+private:
+    void OR() noexcept;
+    void AND() noexcept;
+    void XOR() noexcept;
+    void shiftLeft() noexcept;
+    void shiftRight() noexcept;
+    void jumpWithOffset() noexcept;
+    void storeRegisters() noexcept;
+    void loadRegisters() noexcept;
+
+    // Skips, drawing and the SUPER-CHIP and XO-CHIP additions, which only some profiles decode
+    void skipIfEqual() noexcept;
+    void skipIfNotEqual() noexcept;
+    void skipIfRegistersEqual() noexcept;
+    void skipIfRegistersNotEqual() noexcept;
+    void skipIfKeyPressed() noexcept;
+    void skipIfKeyNotPressed() noexcept;
+    void skipNextInstruction() noexcept;
+    void drawOnDisplay() noexcept;
+    void scrollDown() noexcept;
+    void scrollUp() noexcept;
+    void scrollRight() noexcept;
+    void scrollLeft() noexcept;
+    void lowResolution() noexcept;
+    void highResolution() noexcept;
+    void selectPlanes() noexcept;
+    void loadLongIndex() noexcept;
+
+    // Counts and traces, then runs the handler
+    void dispatch(Opcode op) noexcept;
+    void handle(Opcode op) noexcept;
+    void executeBlocks(int cycles) noexcept;
+
+public:
+    using quirks_t = Quirks;
+
+    using CPU::CPU;
+
+    void decode() noexcept override;
+    void execute(int cycles) noexcept override;
 };
+
+using CosmacCPU = BasicCPU<quirks::Cosmac>;
+using Chip48CPU = BasicCPU<quirks::Chip48>;
+using SuperChipCPU = BasicCPU<quirks::SuperChip>;
+using XoChipCPU = BasicCPU<quirks::XoChip>;
+
+// Instantiated once in cpu.cpp
+extern template class BasicCPU<quirks::Cosmac>;
+extern template class BasicCPU<quirks::Chip48>;
+extern template class BasicCPU<quirks::SuperChip>;
+extern template class BasicCPU<quirks::XoChip>;
+
+[[nodiscard]] std::unique_ptr<CPU> makeCPU(Profile profile, Memory* memory) noexcept;
@@ -1,5 +1,10 @@
 #pragma once
 #include "utils.hpp"
+#include "hash.hpp"
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
 
 enum class Pixel
 {
@@ -7,32 +12,371 @@ enum class Pixel
     on = 1
 };
 
-using display_t = std::array<std::array<Pixel, display::WIDTH>, display::HEIGHT>;
+// 64 pixels, the most significant bit is the leftmost pixel
+using display_word_t = uint64_t;
+
+namespace display
+{
+    constexpr int WORD_BITS {64};
+    constexpr int WORDS_PER_ROW {HIRES_WIDTH / WORD_BITS};
+
+    // Folded into Display::hash() in high resolution, so a blank screen hashes differently in each mode
+    constexpr uint64_t HIRES_HASH {0x9e3779b97f4a7c15};
+
+    constexpr int HASHED_WORDS {PLANES * HIRES_HEIGHT * WORDS_PER_ROW};
+
+    // One key per framebuffer word, so the same pixels in another place hash differently
+    constexpr std::array<uint64_t, HASHED_WORDS> HASH_KEYS {[]
+    {
+        std::array<uint64_t, HASHED_WORDS> keys {};
+        for (int i{0}; i < HASHED_WORDS; ++i)
+        {
+            keys[i] = hash::mix64(static_cast<uint64_t>(i) + 1);
+        }
+        return keys;
+    }()};
+}
+
+// Rows are always high resolution wide, low resolution only uses the first word and the top 32 rows
+using display_row_t = std::array<display_word_t, display::WORDS_PER_ROW>;
+using display_plane_t = std::array<display_row_t, display::HIRES_HEIGHT>;
+using display_t = std::array<display_plane_t, display::PLANES>;
+
+// One bit per row, bit y set when row y changed in any plane
+using dirty_rows_t = uint64_t;
+
+static_assert(display::WIDTH == display::WORD_BITS, "a low resolution row must fill exactly one word");
+static_assert(display::HIRES_HEIGHT <= 64, "every row needs a bit in dirty_rows_t");
+
+// Everything a snapshot needs to redraw the screen
+struct Framebuffer
+{
+    display_t planes {};
+    bool hires {false};
+    uint8_t plane_mask {1}; // bit n set when plane n is drawn to
+
+    constexpr bool operator==(const Framebuffer&) const noexcept = default;
+};
 
 class Display
 {
 private:
-    display_t display_buffer {};
+    Framebuffer framebuffer {};
+    dirty_rows_t dirty_rows {};
+    uint64_t frame_generation {};
+    uint64_t pixel_hash {};
+    // When the first change since the last takeChangeTime() was made
+    std::chrono::steady_clock::time_point first_change {};
+    bool change_pending {false};
+
+    // A word's share of the hash, XORed in and out as the word changes. Blank words add nothing
+    [[nodiscard]] static constexpr uint64_t wordHash(int plane, int y, int word, display_word_t value) noexcept
+    {
+        if (value == 0)
+            return 0;
+
+        return hash::mix64(value ^ display::HASH_KEYS[(plane * display::HIRES_HEIGHT + y) * display::WORDS_PER_ROW + word]);
+    }
+
+    [[nodiscard]] static constexpr display_word_t mask(int x) noexcept
+    {
+        return display_word_t{1} << (display::WORD_BITS - 1 - x % display::WORD_BITS);
+    }
+
+    [[nodiscard]] constexpr bool isSelected(int plane) const noexcept
+    {
+        return framebuffer.plane_mask & (1 << plane);
+    }
+
+    // Reads the clock only for the first change after takeChangeTime(), later ones cost a branch
+    constexpr void bumpGeneration() noexcept
+    {
+        frame_generation++;
+        if (!change_pending && !std::is_constant_evaluated())
+        {
+            first_change = std::chrono::steady_clock::now();
+            change_pending = true;
+        }
+    }
+
+    constexpr void markDirty(int y) noexcept
+    {
+        dirty_rows |= dirty_rows_t{1} << y;
+        bumpGeneration();
+    }
+
+    constexpr void writeRow(int plane, int y, const display_row_t& row) noexcept
+    {
+        if (framebuffer.planes[plane][y] == row)
+            return;
+
+        for (int word{0}; word < display::WORDS_PER_ROW; ++word)
+        {
+            const display_word_t previous {framebuffer.planes[plane][y][word]};
+            if (previous != row[word])
+                pixel_hash ^= wordHash(plane, y, word, previous) ^ wordHash(plane, y, word, row[word]);
+        }
+
+        framebuffer.planes[plane][y] = row;
+        markDirty(y);
+    }
+
+    // Drops whatever fell outside the current resolution
+    [[nodiscard]] constexpr display_row_t clip(display_row_t row) const noexcept
+    {
+        if (!framebuffer.hires)
+            row[1] = 0;
+        return row;
+    }
 
 public:
+    [[nodiscard]] constexpr int width() const noexcept { return framebuffer.hires ? display::HIRES_WIDTH : display::WIDTH; }
+    [[nodiscard]] constexpr int height() const noexcept { return framebuffer.hires ? display::HIRES_HEIGHT : display::HEIGHT; }
+    [[nodiscard]] constexpr bool isHires() const noexcept { return framebuffer.hires; }
+    [[nodiscard]] constexpr uint8_t planeMask() const noexcept { return framebuffer.plane_mask; }
+
+    // Lit in any selected plane
     [[nodiscard]] constexpr Pixel get(int x, int y) const noexcept
     {
-        return display_buffer[y][x];
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            if (isSelected(plane) && (framebuffer.planes[plane][y][x / display::WORD_BITS] & mask(x)))
+                return Pixel::on;
+        }
+        return Pixel::off;
+    }
+
+    // Palette index, one bit per plane
+    [[nodiscard]] constexpr int color(int x, int y) const noexcept
+    {
+        int index {0};
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            if (framebuffer.planes[plane][y][x / display::WORD_BITS] & mask(x))
+                index |= 1 << plane;
+        }
+        return index;
     }
 
     constexpr void set(int x, int y, Pixel val) noexcept
     {
-        display_buffer[y][x] = val;
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            if (!isSelected(plane))
+                continue;
+
+            display_row_t row {framebuffer.planes[plane][y]};
+            if (val == Pixel::on)
+                row[x / display::WORD_BITS] |= mask(x);
+            else
+                row[x / display::WORD_BITS] &= ~mask(x);
+            writeRow(plane, y, row);
+        }
     }
 
+    // Clears the selected planes
     constexpr void clear() noexcept
     {
-        for (int y{0}; y < display::HEIGHT; ++y)
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            if (!isSelected(plane))
+                continue;
+
+            for (int y{0}; y < display::HIRES_HEIGHT; ++y)
+            {
+                writeRow(plane, y, {});
+            }
+        }
+    }
+
+    // Switching resolution clears every plane, as on XO-CHIP
+    constexpr void setHires(bool hires) noexcept
+    {
+        framebuffer.hires = hires;
+        for (auto& plane : framebuffer.planes)
+        {
+            plane = {};
+        }
+        pixel_hash = 0;
+        dirty_rows = ~dirty_rows_t{0};
+        bumpGeneration();
+    }
+
+    constexpr void selectPlanes(uint8_t mask) noexcept
+    {
+        framebuffer.plane_mask = mask & ((1 << display::PLANES) - 1);
+    }
+
+    // XORs up to 16 sprite pixels, left aligned in sprite, into a plane at (x, y).
+    // Clips at the right edge and reports whether a lit pixel was turned off
+    constexpr bool drawSpriteRow(int plane, int x, int y, uint16_t sprite) noexcept
+    {
+        const display_word_t bits {static_cast<display_word_t>(sprite) << (display::WORD_BITS - 16)};
+        display_row_t sprite_row {};
+
+        if (x < display::WORD_BITS)
+        {
+            sprite_row[0] = bits >> x;
+            sprite_row[1] = x == 0 ? 0 : bits << (display::WORD_BITS - x);
+        }
+        else
+            sprite_row[1] = bits >> (x - display::WORD_BITS);
+
+        sprite_row = clip(sprite_row);
+
+        const display_row_t& row {framebuffer.planes[plane][y]};
+        const bool collision {((row[0] & sprite_row[0]) | (row[1] & sprite_row[1])) != 0};
+        writeRow(plane, y, {row[0] ^ sprite_row[0], row[1] ^ sprite_row[1]});
+        return collision;
+    }
+
+    // A byte wide sprite row in the first plane
+    constexpr bool drawSpriteRow(int x, int y, uint8_t sprite_byte) noexcept
+    {
+        return drawSpriteRow(0, x, y, static_cast<uint16_t>(sprite_byte << 8));
+    }
+
+    // Scrolls the selected planes by whole rows, rows scrolled in are blank
+    constexpr void scrollDown(int rows) noexcept
+    {
+        for (int plane{0}; plane < display::PLANES; ++plane)
         {
-            for (int x{0}; x < display::WIDTH; ++x)
+            if (!isSelected(plane))
+                continue;
+
+            for (int y{height() - 1}; y >= 0; --y)
             {
-                set(x, y, Pixel::off);
+                writeRow(plane, y, y >= rows ? framebuffer.planes[plane][y - rows] : display_row_t{});
             }
         }
     }
+
+    constexpr void scrollUp(int rows) noexcept
+    {
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            if (!isSelected(plane))
+                continue;
+
+            for (int y{0}; y < height(); ++y)
+            {
+                writeRow(plane, y, y + rows < height() ? framebuffer.planes[plane][y + rows] : display_row_t{});
+            }
+        }
+    }
+
+    // Horizontal scrolls shift each row as one 128-bit value, at most a word wide
+    constexpr void scrollRight(int pixels) noexcept
+    {
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            if (!isSelected(plane))
+                continue;
+
+            for (int y{0}; y < height(); ++y)
+            {
+                const display_row_t& row {framebuffer.planes[plane][y]};
+                writeRow(plane, y, clip({row[0] >> pixels, (row[1] >> pixels) | (row[0] << (display::WORD_BITS - pixels))}));
+            }
+        }
+    }
+
+    constexpr void scrollLeft(int pixels) noexcept
+    {
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            if (!isSelected(plane))
+                continue;
+
+            for (int y{0}; y < height(); ++y)
+            {
+                const display_row_t& row {framebuffer.planes[plane][y]};
+                writeRow(plane, y, {(row[0] << pixels) | (row[1] >> (display::WORD_BITS - pixels)), row[1] << pixels});
+            }
+        }
+    }
+
+    // Only rows that differ from the current frame are marked dirty, a resolution change marks them all
+    constexpr void restore(const Framebuffer& other) noexcept
+    {
+        if (other.hires != framebuffer.hires)
+        {
+            dirty_rows = ~dirty_rows_t{0};
+            bumpGeneration();
+        }
+
+        framebuffer.hires = other.hires;
+        framebuffer.plane_mask = other.plane_mask;
+
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            for (int y{0}; y < display::HIRES_HEIGHT; ++y)
+            {
+                writeRow(plane, y, other.planes[plane][y]);
+            }
+        }
+    }
+
+    [[nodiscard]] constexpr const display_t& rows() const noexcept
+    {
+        return framebuffer.planes;
+    }
+
+    [[nodiscard]] constexpr const Framebuffer& state() const noexcept
+    {
+        return framebuffer;
+    }
+
+    [[nodiscard]] constexpr dirty_rows_t dirtyRows() const noexcept
+    {
+        return dirty_rows;
+    }
+
+    // Hands the changed rows to the presenter and starts tracking afresh
+    constexpr dirty_rows_t takeDirtyRows() noexcept
+    {
+        const dirty_rows_t rows {dirty_rows};
+        dirty_rows = 0;
+        return rows;
+    }
+
+    // 64-bit hash of every plane and the resolution, kept up to date as rows are written so reading it is free.
+    // Equal framebuffers hash equal whatever route they took, see hashOf()
+    [[nodiscard]] constexpr uint64_t hash() const noexcept
+    {
+        return pixel_hash ^ (framebuffer.hires ? display::HIRES_HASH : 0);
+    }
+
+    // The same hash computed from scratch
+    [[nodiscard]] static constexpr uint64_t hashOf(const Framebuffer& framebuffer) noexcept
+    {
+        uint64_t result {framebuffer.hires ? display::HIRES_HASH : 0};
+        for (int plane{0}; plane < display::PLANES; ++plane)
+        {
+            for (int y{0}; y < display::HIRES_HEIGHT; ++y)
+            {
+                for (int word{0}; word < display::WORDS_PER_ROW; ++word)
+                {
+                    result ^= wordHash(plane, y, word, framebuffer.planes[plane][y][word]);
+                }
+            }
+        }
+        return result;
+    }
+
+    // Bumped on every change, an unchanged generation means there is nothing new to present
+    [[nodiscard]] constexpr uint64_t generation() const noexcept
+    {
+        return frame_generation;
+    }
+
+    // When the first change since the previous call was made, empty when nothing changed since
+    [[nodiscard]] std::optional<std::chrono::steady_clock::time_point> takeChangeTime() noexcept
+    {
+        if (!change_pending)
+            return std::nullopt;
+
+        change_pending = false;
+        return first_change;
+    }
 };
@@ -1,51 +1,305 @@
 #include "emulator.hpp"
+#include "hash.hpp"
 
-void Emulator::draw() noexcept
-{        
-    for (int y{0}; y < display::HEIGHT; ++y)
+namespace
+{
+    // COSMAC VIP keypad laid over the left-hand block of a QWERTY keyboard, indexed by CHIP-8 key
+    constexpr std::array<sf::Keyboard::Key, 16> KEYMAP {
+        sf::Keyboard::X,
+        sf::Keyboard::Num1, sf::Keyboard::Num2, sf::Keyboard::Num3,
+        sf::Keyboard::Q, sf::Keyboard::W, sf::Keyboard::E,
+        sf::Keyboard::A, sf::Keyboard::S, sf::Keyboard::D,
+        sf::Keyboard::Z, sf::Keyboard::C,
+        sf::Keyboard::Num4, sf::Keyboard::R, sf::Keyboard::F, sf::Keyboard::V
+    };
+
+    // How long the render thread naps when no new frame has been published
+    constexpr std::chrono::milliseconds POLL_INTERVAL {1};
+}
+
+void Emulator::setKey(sf::Keyboard::Key key, bool pressed) noexcept
+{
+    // Only the render thread writes the keypad, so a plain load and store is enough
+    uint16_t keys {keypad.load(std::memory_order_relaxed)};
+    for (std::size_t i{0}; i < KEYMAP.size(); ++i)
     {
-        for (int x{0}; x < display::WIDTH; ++x)
-        {
-            if (cpu.display.get(x, y) == Pixel::on)
-            {
-                sf::RectangleShape rect{{display::PIXEL_SIZE, display::PIXEL_SIZE}};
-                rect.setFillColor(sf::Color::White);
-
-                constexpr auto scale {static_cast<float>(display::PIXEL_SIZE)};
-                rect.setPosition({x * scale, y * scale});
-                
-                window.draw(rect);
-            }
-        }
+        if (KEYMAP[i] != key)
+            continue;
+
+        if (pressed)
+            keys |= 1 << i;
+        else
+            keys &= ~(1 << i);
+    }
+    keypad.store(keys, std::memory_order_relaxed);
+}
+
+void Emulator::handleEvents() noexcept
+{
+    sf::Event event;
+    while (window.pollEvent(event))
+    {
+        if (event.type == sf::Event::Closed)
+            window.close();
+        else if (event.type == sf::Event::Resized || event.type == sf::Event::GainedFocus)
+            force_present = true;
+        else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Tab)
+            fast_forward.store(!fast_forward.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        else if ((event.type == sf::Event::KeyPressed || event.type == sf::Event::KeyReleased) && event.key.code == sf::Keyboard::Backspace)
+            rewinding.store(event.type == sf::Event::KeyPressed, std::memory_order_relaxed);
+        else if (event.type == sf::Event::KeyPressed || event.type == sf::Event::KeyReleased)
+            setKey(event.key.code, event.type == sf::Event::KeyPressed);
+    }
+}
+
+void Emulator::present() noexcept
+{
+    const bool published {frames.consume()};
+    const PresentedFrame& shown {frames.readBuffer()};
+
+    // Unchanged frames are neither uploaded nor presented
+    if ((!published || shown.generation == presented_generation) && !force_present)
+    {
+        std::this_thread::sleep_for(POLL_INTERVAL);
+        return;
+    }
+
+    renderer.update(shown.framebuffer);
+
+    window.clear();
+    renderer.draw(window);
+    window.display();
+
+    // Latency runs from the instruction that first changed the display to the end of the buffer swap
+    if (shown.generation != presented_generation)
+    {
+        const auto latency {std::chrono::steady_clock::now() - shown.changed_at};
+        latency_total += latency;
+        latency_max = std::max<std::chrono::nanoseconds>(latency_max, latency);
+        latency_samples++;
     }
+
+    presented_generation = shown.generation;
+    force_present = false;
+}
+
+void Emulator::updateTitle(const PresentedFrame& shown) noexcept
+{
+    const sf::Time elapsed {title_clock.getElapsedTime()};
+    if (elapsed < sf::seconds(1))
+        return;
+
+    // Emulated time over wall time, 100% is real time
+    const double emulated_seconds {std::chrono::duration<double>(timer::FRAME_DURATION).count() * (shown.emulated_frames - title_frames)};
+    const std::string speed {std::to_string(static_cast<int>(emulated_seconds / elapsed.asSeconds() * 100)) + "%"};
+    title_frames = shown.emulated_frames;
+
+    const auto to_ms = [](std::chrono::nanoseconds time) { return std::to_string(std::chrono::duration<double, std::milli>{time}.count()); };
+    const std::string latency {latency_samples == 0 ? "-" : to_ms(latency_total / latency_samples) + " ms avg, " + to_ms(latency_max) + " ms max"};
+
+    window.setTitle(window::TITLE + (fast_forward.load(std::memory_order_relaxed) ? " - fast-forward " : " - speed ") + speed
+                    + " - render " + std::to_string(renderer.averageFrameMicroseconds()) + " us/frame"
+                    + " - latency " + latency
+                    + " - rewind " + std::to_string(shown.rewind_bytes / 1024) + " KB, "
+                    + std::to_string(static_cast<int>(shown.rewind_bytes_per_frame)) + " B/frame");
+    renderer.resetFrameTime();
+    latency_total = {};
+    latency_max = {};
+    latency_samples = 0;
+    title_clock.restart();
+}
+
+void Emulator::updateSound() noexcept
+{
+    // Rings the terminal bell once per tone instead of on every timer tick
+    const bool active {cpu->isSoundActive()};
+    if (active && !sound_active)
+        std::cout << '\a' << std::flush;
+
+    sound_active = active;
 }
 
-Emulator::Emulator(Memory* memory) noexcept :
+Emulator::Emulator(Memory* memory, const EmulatorOptions& options) noexcept :
     window {sf::VideoMode{window::WIDTH, window::HEIGHT}, window::TITLE},
-    cpu {memory}
+    cpu {makeCPU(options.profile, memory)},
+    options {options},
+    fast_forward {options.fast_forward},
+    rewind_buffer {options.rewind_capacity}
 {   
+    window.setVerticalSyncEnabled(true);
+
+    cpu->backend = options.backend;
+    cpu->seed(options.seed);
+
+    input_recording.seed = options.seed;
+    input_recording.cycles_per_frame = options.cycles_per_frame;
+    input_recording.rom_hash = hash::fnv1a(memory->data().data(), memory->data().size());
+
+    if (!options.trace_path.empty())
+    {
+        tracer = std::make_unique<TraceRecorder>(options.trace_path);
+        if (tracer->isOpen())
+            cpu->tracer = &tracer->addStream();
+        else
+            std::cout << "Could not write trace " << options.trace_path << '\n';
+    }
+
+    if (!options.capture_path.empty())
+    {
+        capture = std::make_unique<FrameCapture>(options.capture_path, options.capture_format);
+        if (!capture->isOpen())
+        {
+            std::cout << "Could not write capture " << options.capture_path << '\n';
+            capture.reset();
+        }
+    }
+
+    if (!options.profile_path.empty())
+    {
+        if (!instrumentation::ENABLED)
+            std::cout << "Warning: built without CHIP8_INSTRUMENTATION, no profile will be written\n";
+        instrumentation::installDumpSignal();
+    }
 }
 
-void Emulator::run() noexcept
+void Emulator::dumpProfile() noexcept
 {
-    std::thread delay_timer_thread {&CPU::decreaseDelayTimer, &cpu};
-    std::thread sound_timer_thread {&CPU::decreaseSoundTimer, &cpu};
+    if (options.profile_path.empty() || !instrumentation::ENABLED)
+        return;
 
-    while (window.isOpen())
+    if (!cpu->profile.writeJson(options.profile_path))
+        std::cout << "Could not write profile " << options.profile_path << '\n';
+}
+
+void Emulator::stepFrame() noexcept
+{
+    MachineState state {};
+
+    // Steps back one frame per host frame while held, a recording must stay a straight run so it disables rewinding
+    if (rewinding.load(std::memory_order_relaxed) && options.record_path.empty() && frame > rewind_buffer.oldestFrame())
+    {
+        frame--;
+        if (rewind_buffer.rewindTo(frame, state))
+            cpu->loadState(state);
+        return;
+    }
+
+    // Each entry holds the machine as it was at the start of its frame
+    if (rewind_buffer.empty() || frame > rewind_buffer.newestFrame())
+    {
+        cpu->saveState(state);
+        rewind_buffer.push(frame, state);
+    }
+
+    // Input is latched once per frame so a replay can feed it back at the same point
+    cpu->keypad = keypad.load(std::memory_order_relaxed);
+    input_recording.record(frame, cpu->keypad);
+    if (cpu->isHalted())
+    {
+        cpu->skipHaltedFrames(1, options.cycles_per_frame);
+        cpu->endFrame();
+    }
+    else
+        cpu->runFrame(options.cycles_per_frame);
+
+    // Numbered by emulated time, so frames stepped back over while rewinding are not in the capture
+    if (capture)
+        capture->capture(emulated_frames, cpu->display);
+    frame++;
+    emulated_frames++;
+}
+
+void Emulator::publishFrame() noexcept
+{
+    // Stamped by the display at the first draw, clear or scroll that changed it since the last publish
+    const auto changed_at {cpu->display.takeChangeTime()};
+
+    if (changed_at && !has_unseen_change)
+    {
+        unseen_change = *changed_at;
+        has_unseen_change = true;
+    }
+
+    PresentedFrame& out {frames.writeBuffer()};
+    out.framebuffer = cpu->display.state();
+    out.generation = cpu->display.generation();
+    out.changed_at = unseen_change;
+    out.emulated_frames = emulated_frames;
+    out.rewind_bytes = rewind_buffer.storedBytes();
+    out.rewind_bytes_per_frame = rewind_buffer.bytesPerFrame();
+
+    // A consumed previous frame means every change up to it has been seen, only this frame's own change is still pending
+    if (!frames.publish())
+    {
+        has_unseen_change = changed_at.has_value();
+        unseen_change = changed_at.value_or(unseen_change);
+    }
+}
+
+void Emulator::emulate() noexcept
+{
+    auto next_frame {std::chrono::steady_clock::now()};
+
+    while (running.load(std::memory_order_relaxed))
     {
-        window.clear();
-        sf::Event event;
-        while (window.pollEvent(event))
+        // Fast-forward runs several whole frames per host frame, so timers tick with emulated time
+        // and only the last of them is published. A halted frame still goes through stepFrame() one
+        // at a time, rewind and the recording keep an entry for every frame, it only skips the slice
+        const int batch {fast_forward.load(std::memory_order_relaxed) ? options.fast_forward_factor : 1};
+        for (int i{0}; i < batch; ++i)
         {
-            if (event.type == sf::Event::Closed)
-                window.close();
+            stepFrame();
         }
+        updateSound();
+        publishFrame();
+
+        if (instrumentation::takeDumpRequest())
+            dumpProfile();
+
+        // Paced to 60 Hz, a host that fell behind resynchronises instead of racing to catch up
+        next_frame += timer::FRAME_DURATION;
+        const auto now {std::chrono::steady_clock::now()};
+        if (next_frame < now)
+            next_frame = now;
+
+        std::this_thread::sleep_until(next_frame);
+    }
+
+    dumpProfile();
+}
+
+void Emulator::run() noexcept
+{
+    if (tracer)
+        tracer->start();
+    if (capture)
+        capture->start();
+
+    std::thread emulation {&Emulator::emulate, this};
+
+    while (window.isOpen())
+    {
+        handleEvents();
+        present();
+        updateTitle(frames.readBuffer());
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    emulation.join();
 
-        cpu.fetch();
-        cpu.decode();
+    if (tracer)
+        tracer->stop();
 
-        draw();
+    if (capture)
+    {
+        capture->stop();
+        std::cout << "Captured " << capture->framesWritten() << " changed frames, " << capture->droppedFrames() << " dropped\n";
+    }
 
-        window.display();
-    }   
+    if (!options.record_path.empty())
+    {
+        input_recording.frame_count = frame;
+        if (!input_recording.save(options.record_path))
+            std::cout << "Could not write recording " << options.record_path << '\n';
+    }
 }
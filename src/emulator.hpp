@@ -1,16 +1,93 @@
 #pragma once
 #include <SFML/Graphics.hpp>
+#include <atomic>
+#include <iostream>
+#include <thread>
 #include "cpu.hpp"
+#include "renderer.hpp"
+#include "recording.hpp"
+#include "rewind.hpp"
+#include "triple_buffer.hpp"
+#include "trace.hpp"
+#include "capture.hpp"
 
+struct EmulatorOptions
+{
+    Backend backend {Backend::interpreter};
+    Profile profile {Profile::cosmac};
+    int cycles_per_frame {timer::CYCLES_PER_FRAME};
+    uint32_t seed {};
+    std::string record_path {};
+    std::size_t rewind_capacity {history::DEFAULT_CAPACITY};
+    std::string profile_path {};
+    int fast_forward_factor {timer::FAST_FORWARD_FACTOR};
+    std::string trace_path {};
+    std::string capture_path {};
+    CaptureFormat capture_format {CaptureFormat::delta};
+    bool fast_forward {false};
+};
+
+// A completed frame as handed from the emulation thread to the render thread
+struct PresentedFrame
+{
+    Framebuffer framebuffer {};
+    uint64_t generation {};
+    // When the oldest change the render thread has not yet seen was drawn, as stamped by the display
+    std::chrono::steady_clock::time_point changed_at {};
+    uint64_t emulated_frames {};
+    std::size_t rewind_bytes {};
+    double rewind_bytes_per_frame {};
+};
+
+// The render thread owns the window and polls input, the emulation thread owns the CPU.
+// They share only atomics and the triple buffer of completed frames, so neither waits for the other
 class Emulator
 {
 private:
     sf::RenderWindow window;
-    CPU cpu;
+    std::unique_ptr<CPU> cpu;
+    EmulatorOptions options;
+    TripleBuffer<PresentedFrame> frames {};
+    std::atomic<bool> running {true};
+    std::atomic<uint16_t> keypad {};
+    std::atomic<bool> rewinding {false};
+    std::atomic<bool> fast_forward {false};
+
+    // Render thread
+    Renderer renderer;
+    sf::Clock title_clock;
+    uint64_t presented_generation {};
+    bool force_present {true};
+    uint64_t title_frames {};
+    std::chrono::nanoseconds latency_total {};
+    std::chrono::nanoseconds latency_max {};
+    int latency_samples {};
+
+    // Emulation thread
+    bool sound_active {false};
+    uint64_t frame {};
+    uint64_t emulated_frames {};
+    InputRecording input_recording {};
+    RewindBuffer rewind_buffer;
+    std::unique_ptr<TraceRecorder> tracer {};
+    std::unique_ptr<FrameCapture> capture {};
+    std::chrono::steady_clock::time_point unseen_change {};
+    bool has_unseen_change {false};
 
-    void draw() noexcept;
+    void handleEvents() noexcept;
+    void present() noexcept;
+    void updateTitle(const PresentedFrame& shown) noexcept;
+    void setKey(sf::Keyboard::Key key, bool pressed) noexcept;
+
+    void emulate() noexcept;
+    void updateSound() noexcept;
+    void stepFrame() noexcept;
+    void publishFrame() noexcept;
+    void dumpProfile() noexcept;
 
 public:
-    explicit Emulator(Memory* memory) noexcept;
+    Emulator(Memory* memory, const EmulatorOptions& options) noexcept;
+
+    // Emulates on a second thread and presents on this one until the window closes
     void run() noexcept;
 };
@@ -0,0 +1,86 @@
+#pragma once
+#include "binary_io.hpp"
+#include <cstdint>
+#include <vector>
+
+// A value that holds from frame on, until the next change
+template <typename T>
+struct FrameChange
+{
+    uint64_t frame {};
+    T value {};
+};
+
+// A per-frame value stored as its changes only, recorded and then played back in increasing frame
+// order. The value is T{} before the first change
+template <typename T>
+class FrameLog
+{
+private:
+    std::vector<FrameChange<T>> changes {};
+    std::size_t next_change {};
+    T playback_value {};
+
+public:
+    // Value at a frame, stored only when it differs from the one before
+    void record(uint64_t frame, T value) noexcept
+    {
+        const T previous {changes.empty() ? T{} : changes.back().value};
+        if (value != previous)
+            changes.push_back({frame, value});
+    }
+
+    // Value at a frame, frames must be requested in increasing order
+    [[nodiscard]] T valueAt(uint64_t frame) noexcept
+    {
+        while (next_change < changes.size() && changes[next_change].frame <= frame)
+        {
+            playback_value = changes[next_change].value;
+            next_change++;
+        }
+
+        return playback_value;
+    }
+
+    // Frame of the first change valueAt() has not reached yet, UINT64_MAX when there is none
+    [[nodiscard]] uint64_t nextChangeFrame() const noexcept
+    {
+        return next_change < changes.size() ? changes[next_change].frame : UINT64_MAX;
+    }
+
+    [[nodiscard]] const std::vector<FrameChange<T>>& entries() const noexcept { return changes; }
+
+    // A count, then (frame, value) pairs
+    void write(std::ostream& os) const
+    {
+        binary_io::write(os, static_cast<uint64_t>(changes.size()));
+        for (const FrameChange<T>& change : changes)
+        {
+            binary_io::write(os, change.frame);
+            binary_io::write(os, change.value);
+        }
+    }
+
+    // Replaces the log and rewinds playback, false on a short or corrupt file
+    bool read(std::istream& is)
+    {
+        changes.clear();
+        next_change = 0;
+        playback_value = T{};
+
+        uint64_t count {};
+        if (!binary_io::read(is, count))
+            return false;
+
+        for (uint64_t i{0}; i < count; ++i)
+        {
+            FrameChange<T> change {};
+            if (!binary_io::read(is, change.frame) || !binary_io::read(is, change.value))
+                return false;
+
+            changes.push_back(change);
+        }
+
+        return true;
+    }
+};
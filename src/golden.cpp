@@ -0,0 +1,34 @@
+#include "golden.hpp"
+#include "binary_io.hpp"
+#include <fstream>
+
+bool GoldenRecording::save(const std::string& path) const noexcept
+{
+    std::ofstream ofs {path, std::ios::binary};
+
+    binary_io::writeHeader(ofs, golden::MAGIC, golden::VERSION);
+    binary_io::write(ofs, profile);
+    binary_io::write(ofs, seed);
+    binary_io::write(ofs, static_cast<uint32_t>(cycles_per_frame));
+    binary_io::write(ofs, rom_hash);
+    binary_io::write(ofs, frame_count);
+    changes.write(ofs);
+
+    return ofs.good();
+}
+
+bool GoldenRecording::load(const std::string& path) noexcept
+{
+    std::ifstream ifs {path, std::ios::binary};
+
+    uint32_t cycles {};
+
+    if (!binary_io::readHeader(ifs, golden::MAGIC, golden::VERSION))
+        return false;
+    if (!binary_io::read(ifs, profile) || !binary_io::read(ifs, seed) || !binary_io::read(ifs, cycles) || !binary_io::read(ifs, rom_hash) ||
+        !binary_io::read(ifs, frame_count))
+        return false;
+
+    cycles_per_frame = static_cast<int>(cycles);
+    return changes.read(ifs);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "frame_log.hpp"
+#include <cstdint>
+#include <string>
+
+namespace golden
+{
+    constexpr uint32_t MAGIC {0x44473843}; // "C8GD"
+    constexpr uint16_t VERSION {1};
+}
+
+using GoldenFrame = FrameChange<uint64_t>;
+
+// Known-good framebuffer hash at the end of every frame of a run, stored as changes only.
+// The run itself is pinned by the binary, quirks profile, seed, frame rate and length it was made with
+class GoldenRecording
+{
+private:
+    FrameLog<uint64_t> changes {};
+
+public:
+    uint8_t profile {};
+    uint32_t seed {};
+    int cycles_per_frame {};
+    uint64_t rom_hash {};
+    uint64_t frame_count {};
+
+    // Hash at the end of a frame, frames must be recorded in increasing order
+    void record(uint64_t frame, uint64_t hash) noexcept { changes.record(frame, hash); }
+
+    // Expected hash at the end of a frame, frames must be requested in increasing order
+    [[nodiscard]] uint64_t hashAt(uint64_t frame) noexcept { return changes.valueAt(frame); }
+
+    // Frame of the first change hashAt() has not reached yet, UINT64_MAX when there is none
+    [[nodiscard]] uint64_t nextChangeFrame() const noexcept { return changes.nextChangeFrame(); }
+
+    [[nodiscard]] const std::vector<GoldenFrame>& hashChanges() const noexcept { return changes.entries(); }
+
+    bool save(const std::string& path) const noexcept;
+    bool load(const std::string& path) noexcept;
+};
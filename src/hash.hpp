@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace hash
+{
+    constexpr uint64_t FNV_OFFSET {0xcbf29ce484222325};
+    constexpr uint64_t FNV_PRIME {0x100000001b3};
+
+    // FNV-1a, stable across runs and platforms
+    constexpr uint64_t fnv1a(const uint8_t* data, std::size_t size, uint64_t hash = FNV_OFFSET) noexcept
+    {
+        for (std::size_t i{0}; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= FNV_PRIME;
+        }
+
+        return hash;
+    }
+
+    constexpr uint64_t fnv1a(uint64_t value, uint64_t hash = FNV_OFFSET) noexcept
+    {
+        for (int i{0}; i < 8; ++i)
+        {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= FNV_PRIME;
+        }
+
+        return hash;
+    }
+
+    // splitmix64 finaliser, every input bit reaches every output bit
+    constexpr uint64_t mix64(uint64_t value) noexcept
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+        return value ^ (value >> 31);
+    }
+}
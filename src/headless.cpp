@@ -0,0 +1,384 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include "cpu.hpp"
+#include "hash.hpp"
+#include "recording.hpp"
+#include "machine_state.hpp"
+#include "rewind.hpp"
+#include "call_graph.hpp"
+#include "trace.hpp"
+#include "capture.hpp"
+#include "golden.hpp"
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: chip8-headless <binary file> [--instructions N | --frames N]\n"
+                  << "                      [--cycles-per-frame N] [--block-cache] [--seed N]\n"
+                  << "                      [--profile cosmac|chip48|superchip|xochip]\n"
+                  << "                      [--load-state <snapshot>] [--save-state <snapshot>]\n"
+                  << "                      [--rewind-mb N] [--profile-json <file>]\n"
+                  << "                      [--callgraph <folded stacks file>] [--sample-interval N]\n"
+                  << "                      [--trace <trace file>]\n"
+                  << "                      [--capture <file>] [--capture-format delta|y4m]\n"
+                  << "                      [--golden <file> [--update-golden]]\n"
+                  << "       chip8-headless <binary file> --replay <recording>\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string bin_path {};
+    long long instructions {};
+    long long frames {600};
+    int cycles_per_frame {timer::CYCLES_PER_FRAME};
+    Backend backend {Backend::interpreter};
+    Profile profile {Profile::cosmac};
+    uint32_t seed {};
+    std::string replay_path {};
+    std::string load_state_path {};
+    std::string save_state_path {};
+    std::size_t rewind_capacity {};
+    std::string profile_path {};
+    std::string callgraph_path {};
+    int sample_interval {call_graph::DEFAULT_INTERVAL};
+    std::string trace_path {};
+    std::string capture_path {};
+    CaptureFormat capture_format {CaptureFormat::delta};
+    std::string golden_path {};
+    bool update_golden {false};
+
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string arg {argv[i]};
+        const bool has_value {i + 1 < argc};
+
+        if (arg == "--instructions" && has_value)
+        {
+            instructions = std::stoll(argv[++i]);
+            frames = 0;
+        }
+        else if (arg == "--frames" && has_value)
+        {
+            frames = std::stoll(argv[++i]);
+            instructions = 0;
+        }
+        else if (arg == "--cycles-per-frame" && has_value)
+            cycles_per_frame = std::stoi(argv[++i]);
+        else if (arg == "--block-cache")
+            backend = Backend::blockCache;
+        else if (arg == "--profile" && has_value && parseProfile(argv[i + 1], profile))
+            ++i;
+        else if (arg == "--seed" && has_value)
+            seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--replay" && has_value)
+            replay_path = argv[++i];
+        else if (arg == "--load-state" && has_value)
+            load_state_path = argv[++i];
+        else if (arg == "--save-state" && has_value)
+            save_state_path = argv[++i];
+        else if (arg == "--rewind-mb" && has_value)
+            rewind_capacity = std::stoull(argv[++i]) * 1024 * 1024;
+        else if (arg == "--profile-json" && has_value)
+            profile_path = argv[++i];
+        else if (arg == "--callgraph" && has_value)
+            callgraph_path = argv[++i];
+        else if (arg == "--sample-interval" && has_value)
+            sample_interval = std::stoi(argv[++i]);
+        else if (arg == "--trace" && has_value)
+            trace_path = argv[++i];
+        else if (arg == "--capture" && has_value)
+            capture_path = argv[++i];
+        else if (arg == "--capture-format" && has_value && parseCaptureFormat(argv[i + 1], capture_format))
+            ++i;
+        else if (arg == "--golden" && has_value)
+            golden_path = argv[++i];
+        else if (arg == "--update-golden")
+            update_golden = true;
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage();
+            return -1;
+        }
+        else
+            bin_path = arg;
+    }
+
+    if (bin_path.empty() || (update_golden && golden_path.empty()))
+    {
+        printUsage();
+        return -1;
+    }
+
+    Memory memory {memorySize(profile)};
+    memory.loadProgram(bin_path);
+
+    // A replay brings its own seed, frame rate and length
+    InputRecording replay {};
+    if (!replay_path.empty())
+    {
+        if (!replay.load(replay_path))
+        {
+            std::cout << "Could not read recording " << replay_path << '\n';
+            return -1;
+        }
+
+        if (replay.rom_hash != hash::fnv1a(memory.data().data(), memory.data().size()))
+            std::cout << "Warning: recording was made with a different binary file\n";
+
+        seed = replay.seed;
+        cycles_per_frame = replay.cycles_per_frame;
+        frames = static_cast<long long>(replay.frame_count);
+        instructions = 0;
+    }
+
+    if (cycles_per_frame <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    const auto cpu_ptr {makeCPU(profile, &memory)};
+    CPU& cpu {*cpu_ptr};
+    cpu.backend = backend;
+    cpu.seed(seed);
+
+    // A snapshot replaces the whole machine, including the loaded binary and the seed
+    if (!load_state_path.empty())
+    {
+        MachineState state {};
+        if (!loadSnapshot(load_state_path, state))
+        {
+            std::cout << "Could not read snapshot " << load_state_path << '\n';
+            return -1;
+        }
+        if (static_cast<int>(state.ram_size) != memory.size())
+        {
+            std::cout << "Snapshot " << load_state_path << " has " << state.ram_size << " bytes of RAM, the profile has " << memory.size() << '\n';
+            return -1;
+        }
+        cpu.loadState(state);
+    }
+
+    // A frame is a fixed slice of instructions, so both budgets run uncapped
+    if (frames == 0)
+        frames = (instructions + cycles_per_frame - 1) / cycles_per_frame;
+
+    // A golden file pins the run it was made from, verifying any other run would only report noise
+    GoldenRecording golden {};
+    const uint64_t rom_hash {hash::fnv1a(memory.data().data(), memory.data().size())};
+    if (update_golden)
+    {
+        golden.profile = static_cast<uint8_t>(profile);
+        golden.seed = seed;
+        golden.cycles_per_frame = cycles_per_frame;
+        golden.rom_hash = rom_hash;
+        golden.frame_count = static_cast<uint64_t>(frames);
+    }
+    else if (!golden_path.empty())
+    {
+        if (!golden.load(golden_path))
+        {
+            std::cout << "Could not read golden file " << golden_path << '\n';
+            return -1;
+        }
+
+        if (golden.profile != static_cast<uint8_t>(profile) || golden.seed != seed || golden.cycles_per_frame != cycles_per_frame || golden.rom_hash != rom_hash
+            || golden.frame_count != static_cast<uint64_t>(frames))
+        {
+            std::cout << "Golden file " << golden_path << " was made from a different binary file, profile, seed, frame rate or length\n";
+            return 1;
+        }
+    }
+
+    if (!profile_path.empty())
+    {
+        if (!instrumentation::ENABLED)
+            std::cout << "Warning: built without CHIP8_INSTRUMENTATION, no profile will be written\n";
+        instrumentation::installDumpSignal();
+    }
+
+    // Sizes the rewind history the emulator would keep for this run
+    RewindBuffer rewind_buffer {rewind_capacity};
+    CallGraphSampler sampler {&memory, sample_interval};
+    MachineState state {};
+
+    std::unique_ptr<TraceRecorder> tracer {};
+    if (!trace_path.empty())
+    {
+        tracer = std::make_unique<TraceRecorder>(trace_path);
+        if (!tracer->isOpen())
+        {
+            std::cout << "Could not write trace " << trace_path << '\n';
+            return -1;
+        }
+        cpu.tracer = &tracer->addStream();
+        tracer->start();
+    }
+
+    std::unique_ptr<FrameCapture> capture {};
+    if (!capture_path.empty())
+    {
+        capture = std::make_unique<FrameCapture>(capture_path, capture_format);
+        if (!capture->isOpen())
+        {
+            std::cout << "Could not write capture " << capture_path << '\n';
+            return -1;
+        }
+        capture->start();
+    }
+
+    long long executed {0};
+    long long mismatch_frame {-1};
+    uint64_t expected_hash {};
+
+    // Capture and golden checks look at the framebuffer as each frame ends, false on a golden mismatch
+    const auto finishFrame = [&](long long frame)
+    {
+        if (capture)
+            capture->capture(static_cast<uint64_t>(frame), cpu.display);
+
+        if (update_golden)
+            golden.record(static_cast<uint64_t>(frame), cpu.display.hash());
+        else if (!golden_path.empty() && (expected_hash = golden.hashAt(static_cast<uint64_t>(frame))) != cpu.display.hash())
+        {
+            mismatch_frame = frame;
+            return false;
+        }
+        return true;
+    };
+
+    const auto start {std::chrono::steady_clock::now()};
+
+    for (long long frame{0}; frame < frames; ++frame)
+    {
+        int slice {cycles_per_frame};
+        if (instructions > 0)
+            slice = static_cast<int>(std::min<long long>(slice, instructions - executed));
+
+        if (!replay_path.empty())
+            cpu.keypad = replay.keypadAt(static_cast<uint64_t>(frame));
+
+        // Nothing can leave a halted loop before the next input event, so the frames up to it collapse into one step.
+        // Rewinding and sampling want to see every frame, so they keep running them
+        if (cpu.isHalted() && rewind_capacity == 0 && callgraph_path.empty())
+        {
+            long long last {frames};
+            if (instructions > 0)
+                last = std::min(last, frame + (instructions - executed) / cycles_per_frame);
+            if (!replay_path.empty())
+                last = std::min(last, static_cast<long long>(std::min<uint64_t>(replay.nextEventFrame(), static_cast<uint64_t>(frames))));
+            if (!golden_path.empty() && !update_golden)
+                last = std::min(last, static_cast<long long>(std::min<uint64_t>(golden.nextChangeFrame(), static_cast<uint64_t>(frames))));
+
+            if (last > frame)
+            {
+                cpu.skipHaltedFrames(static_cast<uint64_t>(last - frame), cycles_per_frame);
+                cpu.endFrame();
+                executed += (last - frame) * cycles_per_frame;
+                frame = last - 1;
+                if (!finishFrame(frame))
+                    break;
+                continue;
+            }
+        }
+
+        if (rewind_capacity > 0)
+        {
+            cpu.saveState(state);
+            rewind_buffer.push(static_cast<uint64_t>(frame), state);
+        }
+
+        if (callgraph_path.empty())
+            cpu.execute(slice);
+        else
+            sampler.execute(cpu, slice);
+
+        // A partial last frame ends before its timer tick
+        if (slice == cycles_per_frame)
+            cpu.endFrame();
+
+        executed += slice;
+
+        if (!finishFrame(frame))
+            break;
+
+        if (!profile_path.empty() && instrumentation::takeDumpRequest())
+            cpu.profile.writeJson(profile_path);
+    }
+
+    // Timed with the trace flushed, the writer keeping up is part of the cost
+    if (tracer)
+        tracer->stop();
+    if (capture)
+        capture->stop();
+
+    const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+    if (!profile_path.empty() && instrumentation::ENABLED && !cpu.profile.writeJson(profile_path))
+        std::cout << "Could not write profile " << profile_path << '\n';
+
+    if (!callgraph_path.empty() && !sampler.writeFolded(callgraph_path))
+        std::cout << "Could not write call graph " << callgraph_path << '\n';
+
+    if (!save_state_path.empty())
+    {
+        MachineState state {};
+        cpu.saveState(state);
+        if (!saveSnapshot(save_state_path, state))
+            std::cout << "Could not write snapshot " << save_state_path << '\n';
+    }
+
+    if (update_golden && !golden.save(golden_path))
+        std::cout << "Could not write golden file " << golden_path << '\n';
+
+    const double seconds {std::max(elapsed.count(), 1e-9)};
+
+    std::cout << "instructions:        " << executed << '\n'
+              << "frames:              " << frames << '\n'
+              << "elapsed:             " << elapsed.count() << " s\n"
+              << "instructions/sec:    " << executed / seconds << '\n'
+              << "frames/sec:          " << frames / seconds << '\n'
+              << "elided cycles:       " << cpu.elidedCycles() << '\n'
+              << "predecode hit rate:  " << memory.predecodeHitRate() * 100 << "%\n"
+              << "framebuffer hash:    0x" << std::hex << std::setw(16) << std::setfill('0') << cpu.display.hash() << std::dec << '\n';
+
+    if (rewind_capacity > 0)
+    {
+        std::cout << "rewind frames:       " << rewind_buffer.size() << " (" << rewind_buffer.oldestFrame() << " - " << rewind_buffer.newestFrame() << ")\n"
+                  << "rewind bytes:        " << rewind_buffer.storedBytes() << '\n'
+                  << "rewind bytes/frame:  " << rewind_buffer.bytesPerFrame() << '\n';
+    }
+
+    if (!callgraph_path.empty())
+        std::cout << "call graph samples:  " << sampler.sampleCount() << '\n';
+
+    if (capture)
+    {
+        std::cout << "captured frames:     " << capture->framesWritten() << '\n'
+                  << "dropped frames:      " << capture->droppedFrames() << '\n';
+    }
+
+    if (tracer)
+    {
+        std::cout << "trace records:       " << tracer->recordsWritten() << '\n'
+                  << "trace stalls:        " << tracer->stallCount() << '\n';
+    }
+
+    if (!golden_path.empty())
+    {
+        std::cout << "golden hash changes: " << golden.hashChanges().size() << '\n';
+        if (mismatch_frame >= 0)
+        {
+            std::cout << "golden mismatch:     frame " << mismatch_frame << ", expected 0x" << std::hex << std::setw(16) << std::setfill('0')
+                      << expected_hash << ", got 0x" << std::setw(16) << cpu.display.hash() << std::dec << '\n';
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    std::atomic<bool> dump_requested {false};
+
+    static_assert(std::atomic<bool>::is_always_lock_free, "the signal handler may only touch lock-free atomics");
+
+    void requestDump(int) noexcept
+    {
+        dump_requested.store(true, std::memory_order_relaxed);
+    }
+}
+
+void instrumentation::installDumpSignal() noexcept
+{
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, requestDump);
+#endif
+}
+
+bool instrumentation::takeDumpRequest() noexcept
+{
+    return dump_requested.exchange(false, std::memory_order_relaxed);
+}
+
+void ExecutionProfile::endFrame() noexcept
+{
+    frames++;
+    total_cycles += frame_cycles;
+    total_draws += frame_draws;
+    max_cycles_per_frame = std::max(max_cycles_per_frame, frame_cycles);
+    max_draws_per_frame = std::max(max_draws_per_frame, frame_draws);
+    frame_cycles = 0;
+    frame_draws = 0;
+}
+
+void ExecutionProfile::writeJson(std::ostream& out) const
+{
+    const double per_frame {frames > 0 ? 1.0 / frames : 0.0};
+
+    out << "{\n"
+        << "  \"instructions\": " << total_cycles + frame_cycles << ",\n"
+        << "  \"frames\": " << frames << ",\n"
+        << "  \"cycles_per_frame\": {\"mean\": " << total_cycles * per_frame << ", \"max\": " << max_cycles_per_frame << "},\n"
+        << "  \"draws_per_frame\": {\"mean\": " << total_draws * per_frame << ", \"max\": " << max_draws_per_frame << "},\n"
+        << "  \"opcodes\": {";
+
+    const char* separator {"\n"};
+    for (std::size_t op{0}; op < opcode::COUNT; ++op)
+    {
+        if (opcode_counts[op] == 0)
+            continue;
+
+        out << separator << "    \"" << opcode::NAMES[op] << "\": " << opcode_counts[op];
+        separator = ",\n";
+    }
+
+    // Hottest addresses first
+    std::vector<int> addresses {};
+    for (int address{0}; address < memory::XO_CHIP_SIZE; ++address)
+    {
+        if (addressCount(address) > 0)
+            addresses.push_back(address);
+    }
+    std::stable_sort(addresses.begin(), addresses.end(), [this](int a, int b)
+    {
+        return addressCount(a) > addressCount(b);
+    });
+
+    out << "\n  },\n"
+        << "  \"hot_addresses\": [";
+
+    separator = "\n";
+    for (const int address : addresses)
+    {
+        out << separator << "    {\"address\": " << address << ", \"count\": " << addressCount(address) << '}';
+        separator = ",\n";
+    }
+
+    out << "\n  ]\n"
+        << "}\n";
+}
+
+bool ExecutionProfile::writeJson(const std::string& path) const noexcept
+{
+    std::ofstream ofs {path};
+    writeJson(ofs);
+    return ofs.good();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "opcode.hpp"
+#include "utils.hpp"
+#include <memory>
+#include <string>
+#include <ostream>
+#include <type_traits>
+
+namespace instrumentation
+{
+#ifdef CHIP8_INSTRUMENTATION
+    constexpr bool ENABLED {true};
+#else
+    constexpr bool ENABLED {false};
+#endif
+
+    // Makes a signal (SIGUSR1 where available) request a dump, polled by the front ends once per frame
+    void installDumpSignal() noexcept;
+    [[nodiscard]] bool takeDumpRequest() noexcept;
+}
+
+// Execution counts per opcode and per address, plus per-frame cycle and draw totals
+class ExecutionProfile
+{
+private:
+    std::array<uint64_t, opcode::COUNT> opcode_counts {};
+    // Sized for the largest address space, allocated on the first count so a CPU that never runs stays small
+    std::unique_ptr<std::array<uint64_t, memory::XO_CHIP_SIZE>> address_counts {};
+    uint64_t frames {};
+    uint64_t frame_cycles {};
+    uint64_t frame_draws {};
+    uint64_t total_cycles {};
+    uint64_t total_draws {};
+    uint64_t max_cycles_per_frame {};
+    uint64_t max_draws_per_frame {};
+
+public:
+    void countInstruction(int address, Opcode op) noexcept
+    {
+        opcode_counts[static_cast<std::size_t>(op)]++;
+        if (!address_counts)
+            address_counts = std::make_unique<std::array<uint64_t, memory::XO_CHIP_SIZE>>();
+        (*address_counts)[address & (memory::XO_CHIP_SIZE - 1)]++;
+        frame_cycles++;
+        frame_draws += op == Opcode::drawOnDisplay;
+    }
+
+    void endFrame() noexcept;
+
+    [[nodiscard]] uint64_t opcodeCount(Opcode op) const noexcept { return opcode_counts[static_cast<std::size_t>(op)]; }
+    [[nodiscard]] uint64_t addressCount(int address) const noexcept
+    {
+        return address_counts ? (*address_counts)[address & (memory::XO_CHIP_SIZE - 1)] : 0;
+    }
+    [[nodiscard]] uint64_t frameCount() const noexcept { return frames; }
+    [[nodiscard]] uint64_t maxCyclesPerFrame() const noexcept { return max_cycles_per_frame; }
+    [[nodiscard]] uint64_t maxDrawsPerFrame() const noexcept { return max_draws_per_frame; }
+
+    void writeJson(std::ostream& out) const;
+    bool writeJson(const std::string& path) const noexcept;
+};
+
+// Stands in for ExecutionProfile when instrumentation is compiled out, every call inlines to nothing
+struct NullProfile
+{
+    constexpr void countInstruction(int, Opcode) noexcept {}
+    constexpr void endFrame() noexcept {}
+    bool writeJson(const std::string&) const noexcept { return false; }
+};
+
+using profile_t = std::conditional_t<instrumentation::ENABLED, ExecutionProfile, NullProfile>;
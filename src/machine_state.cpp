@@ -0,0 +1,115 @@
+#include "machine_state.hpp"
+#include "binary_io.hpp"
+#include <fstream>
+
+bool saveSnapshot(const std::string& path, const MachineState& state) noexcept
+{
+    std::ofstream ofs {path, std::ios::binary};
+    const CpuState& cpu {state.cpu};
+
+    binary_io::writeHeader(ofs, snapshot::MAGIC, snapshot::VERSION);
+
+    for (const uint8_t reg : cpu.gp_regs)
+    {
+        binary_io::write(ofs, reg);
+    }
+
+    binary_io::write(ofs, static_cast<uint16_t>(cpu.program_counter));
+    binary_io::write(ofs, static_cast<uint16_t>(cpu.index_reg));
+    binary_io::write(ofs, cpu.cpu_stack.depth);
+    for (const uint16_t entry : cpu.cpu_stack.entries)
+    {
+        binary_io::write(ofs, entry);
+    }
+
+    binary_io::write(ofs, cpu.delay_timer);
+    binary_io::write(ofs, cpu.sound_timer);
+    binary_io::write(ofs, cpu.keypad);
+    binary_io::write(ofs, cpu.rng.state);
+
+    binary_io::write(ofs, state.ram_size);
+    ofs.write(reinterpret_cast<const char*>(state.ram.data()), state.ram_size);
+
+    const Framebuffer& framebuffer {state.framebuffer};
+    binary_io::write(ofs, static_cast<uint8_t>(framebuffer.hires));
+    binary_io::write(ofs, framebuffer.plane_mask);
+    binary_io::write(ofs, static_cast<uint16_t>(framebuffer.planes.size() * display::HIRES_HEIGHT * display::WORDS_PER_ROW));
+    for (const display_plane_t& plane : framebuffer.planes)
+    {
+        for (const display_row_t& row : plane)
+        {
+            for (const display_word_t word : row)
+            {
+                binary_io::write(ofs, word);
+            }
+        }
+    }
+
+    return ofs.good();
+}
+
+bool loadSnapshot(const std::string& path, MachineState& state) noexcept
+{
+    std::ifstream ifs {path, std::ios::binary};
+    MachineState loaded {};
+    CpuState& cpu {loaded.cpu};
+
+    if (!binary_io::readHeader(ifs, snapshot::MAGIC, snapshot::VERSION))
+        return false;
+
+    for (uint8_t& reg : cpu.gp_regs)
+    {
+        if (!binary_io::read(ifs, reg))
+            return false;
+    }
+
+    uint16_t program_counter {};
+    uint16_t index_reg {};
+    if (!binary_io::read(ifs, program_counter) || !binary_io::read(ifs, index_reg) ||
+        !binary_io::read(ifs, cpu.cpu_stack.depth) || cpu.cpu_stack.depth > cpu.cpu_stack.entries.size())
+        return false;
+
+    cpu.program_counter = program_counter;
+    cpu.index_reg = index_reg;
+
+    for (uint16_t& entry : cpu.cpu_stack.entries)
+    {
+        if (!binary_io::read(ifs, entry))
+            return false;
+    }
+
+    if (!binary_io::read(ifs, cpu.delay_timer) || !binary_io::read(ifs, cpu.sound_timer) ||
+        !binary_io::read(ifs, cpu.keypad) || !binary_io::read(ifs, cpu.rng.state))
+        return false;
+
+    // Either address space, the caller checks it against its machine's
+    uint32_t ram_size {};
+    if (!binary_io::read(ifs, ram_size) || (ram_size != memory::SIZE && ram_size != memory::XO_CHIP_SIZE))
+        return false;
+    loaded.ram_size = ram_size;
+    if (!ifs.read(reinterpret_cast<char*>(loaded.ram.data()), ram_size))
+        return false;
+
+    Framebuffer& framebuffer {loaded.framebuffer};
+    uint8_t hires {};
+    uint16_t words {};
+    if (!binary_io::read(ifs, hires) || !binary_io::read(ifs, framebuffer.plane_mask) || !binary_io::read(ifs, words) ||
+        words != framebuffer.planes.size() * display::HIRES_HEIGHT * display::WORDS_PER_ROW)
+        return false;
+
+    framebuffer.hires = hires != 0;
+    for (display_plane_t& plane : framebuffer.planes)
+    {
+        for (display_row_t& row : plane)
+        {
+            for (display_word_t& word : row)
+            {
+                if (!binary_io::read(ifs, word))
+                    return false;
+            }
+        }
+    }
+
+    state = loaded;
+    return true;
+}
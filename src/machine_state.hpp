@@ -0,0 +1,81 @@
+#pragma once
+#include "memory.hpp"
+#include "display.hpp"
+#include "rng.hpp"
+#include <type_traits>
+
+using gp_regs_t = std::array<uint8_t, 16>;
+
+// Fixed 16-level return stack, as on the COSMAC VIP, overflowing calls are dropped
+struct CallStack
+{
+    std::array<uint16_t, 16> entries {};
+    uint8_t depth {};
+
+    constexpr void push(int address) noexcept
+    {
+        if (depth < entries.size())
+            entries[depth++] = static_cast<uint16_t>(address);
+    }
+
+    constexpr void pop() noexcept
+    {
+        if (depth > 0)
+            depth--;
+    }
+
+    [[nodiscard]] constexpr int top() const noexcept
+    {
+        return entries[depth > 0 ? depth - 1 : 0];
+    }
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept
+    {
+        return depth;
+    }
+
+    [[nodiscard]] constexpr bool empty() const noexcept
+    {
+        return depth == 0;
+    }
+
+    constexpr bool operator==(const CallStack&) const noexcept = default;
+};
+
+// Everything the CPU needs to resume execution
+struct CpuState
+{
+    gp_regs_t gp_regs {};
+    int program_counter {memory::PROGRAM_OFFSET};
+    int index_reg {};
+    CallStack cpu_stack {};
+    uint8_t delay_timer {};
+    uint8_t sound_timer {};
+    uint16_t keypad {}; // bit n set while key n is held
+    Rng rng {};
+
+    constexpr bool operator==(const CpuState&) const noexcept = default;
+};
+
+// RAM of the largest profile, a smaller one uses the first ram_size bytes
+using ram_t = std::array<uint8_t, memory::XO_CHIP_SIZE>;
+
+// Whole machine as one flat block, copied and snapshotted with a single memcpy
+struct MachineState
+{
+    CpuState cpu {};
+    Framebuffer framebuffer {};
+    uint32_t ram_size {memory::SIZE}; // the profile's memorySize(), bytes past it are unused
+    ram_t ram {};
+};
+
+static_assert(std::is_trivially_copyable_v<MachineState>);
+
+namespace snapshot
+{
+    constexpr uint32_t MAGIC {0x53533843}; // "C8SS"
+    constexpr uint16_t VERSION {2};
+}
+
+bool saveSnapshot(const std::string& path, const MachineState& state) noexcept;
+bool loadSnapshot(const std::string& path, MachineState& state) noexcept;
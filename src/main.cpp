@@ -6,24 +6,61 @@
 #include <array>
 #include <algorithm>
 #include <cassert>
+#include <random>
 #include <SFML/Graphics.hpp>
 #include "emulator.hpp"
 
 int main(int argc, char* argv[])
 {
-    if (argc < 2)
+    std::string bin_path {};
+    EmulatorOptions options {};
+    options.seed = std::random_device{}();
+
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string arg {argv[i]};
+
+        if (arg == "--block-cache")
+            options.backend = Backend::blockCache;
+        else if (arg == "--profile" && i + 1 < argc && parseProfile(argv[i + 1], options.profile))
+            ++i;
+        else if (arg == "--cycles-per-frame" && i + 1 < argc)
+            options.cycles_per_frame = std::stoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            options.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--record" && i + 1 < argc)
+            options.record_path = argv[++i];
+        else if (arg == "--rewind-mb" && i + 1 < argc)
+            options.rewind_capacity = std::stoull(argv[++i]) * 1024 * 1024;
+        else if (arg == "--fast-forward")
+            options.fast_forward = true;
+        else if (arg == "--fast-forward-factor" && i + 1 < argc)
+            options.fast_forward_factor = std::stoi(argv[++i]);
+        else if (arg == "--trace" && i + 1 < argc)
+            options.trace_path = argv[++i];
+        else if (arg == "--capture" && i + 1 < argc)
+            options.capture_path = argv[++i];
+        else if (arg == "--capture-format" && i + 1 < argc && parseCaptureFormat(argv[i + 1], options.capture_format))
+            ++i;
+        else if (arg == "--profile-json" && i + 1 < argc)
+            options.profile_path = argv[++i];
+        else
+            bin_path = arg;
+    }
+
+    if (bin_path.empty() || options.cycles_per_frame <= 0 || options.fast_forward_factor <= 0)
     {
         std::cout << "Provide a path to the binary file.\n";
         return -1;
     }
 
-    const std::string bin_path {argv[1]};
-
-    Memory memory;
+    Memory memory {memorySize(options.profile)};
     memory.loadProgram(bin_path);
 
-    Emulator emulator {&memory};
+    Emulator emulator {&memory, options};
     emulator.run();
 
+    std::cout << "Predecode cache hit rate: " << memory.predecodeHitRate() * 100 << "%\n";
+
     return 0;
 }
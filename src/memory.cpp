@@ -1,4 +1,5 @@
 #include "memory.hpp"
+#include <algorithm>
 
 void Memory::loadFonts() noexcept
 {
@@ -24,26 +25,82 @@ void Memory::loadFonts() noexcept
     std::copy(std::begin(font_buffer), std::end(font_buffer), std::begin(memory_buffer) + font_buffer::OFFSET);
 }
 
-Memory::Memory() noexcept
+void Memory::invalidatePredecodeCache() noexcept
+{
+    for (auto& entry : predecode_cache)
+    {
+        entry.valid = false;
+    }
+
+    for (auto& generation : page_generations)
+    {
+        generation++;
+    }
+    writes++;
+}
+
+Memory::Memory(int size) noexcept :
+    memory_buffer(static_cast<std::size_t>(size)),
+    predecode_cache(static_cast<std::size_t>(size)),
+    page_generations(static_cast<std::size_t>(std::max(size / memory::PAGE_SIZE, 1))),
+    address_mask {size - 1}
 {
     loadFonts();
 }
 
-void Memory::loadProgram(const std::string& bin_path) noexcept
+bool Memory::loadProgram(const std::string& bin_path) noexcept
 {
+    // Reading a directory or a failing device sets badbit, an empty file only eofbit
     std::ifstream ifs {bin_path, std::ios::binary};
+    ifs.peek();
+    if (!ifs.is_open() || ifs.bad())
+        return false;
 
     // 0x000 to 0x1FF is reserved
     int idx {memory::PROGRAM_OFFSET};
 
-    while (ifs.good())
+    while (ifs.good() && idx < size())
     {
         memory_buffer[idx] = ifs.get();
         idx++;
     }
+
+    invalidatePredecodeCache();
+    return true;
+}
+
+void Memory::loadProgram(const std::vector<uint8_t>& program) noexcept
+{
+    const auto count {std::min<std::size_t>(program.size(), static_cast<std::size_t>(size() - memory::PROGRAM_OFFSET))};
+    std::copy_n(std::begin(program), count, std::begin(memory_buffer) + memory::PROGRAM_OFFSET);
+    invalidatePredecodeCache();
 }
 
 uint8_t Memory::getByte(int offset) const noexcept
 {
-    return memory_buffer[offset];
+    return memory_buffer[offset & address_mask];
+}
+
+void Memory::setByte(int offset, uint8_t value) noexcept
+{
+    offset &= address_mask;
+    memory_buffer[offset] = value;
+    page_generations[offset / memory::PAGE_SIZE]++;
+    writes++;
+
+    // The byte is the first half of the instruction at offset and the second half of the one before it
+    predecode_cache[offset].valid = false;
+    predecode_cache[(offset - 1) & address_mask].valid = false;
+}
+
+void Memory::restore(const uint8_t* contents, std::size_t size) noexcept
+{
+    std::copy_n(contents, std::min(size, memory_buffer.size()), memory_buffer.begin());
+    invalidatePredecodeCache();
+}
+
+double Memory::predecodeHitRate() const noexcept
+{
+    const uint64_t total {predecode_hits + predecode_misses};
+    return total ? static_cast<double>(predecode_hits) / total : 0.0;
 }
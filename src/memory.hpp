@@ -1,17 +1,75 @@
 #pragma once
 #include "utils.hpp"
+#include "opcode.hpp"
+#include <vector>
 
-using memory_t = std::array<uint8_t, memory::SIZE>;
+using memory_t = std::vector<uint8_t>;
 
+// Guest RAM sized by the quirks profile, with the tables derived from it sized to match
 class Memory
 {
 private:
-    memory_t memory_buffer{};
+    memory_t memory_buffer;
+    std::vector<DecodedInstruction> predecode_cache;
+    uint64_t predecode_hits{};
+    uint64_t predecode_misses{};
+    std::vector<uint32_t> page_generations;
+    uint64_t writes{};
+    int address_mask;
     
     void loadFonts() noexcept;
+    void invalidatePredecodeCache() noexcept;
 
 public:
-    Memory() noexcept;
-    void loadProgram(const std::string& bin_path) noexcept;
+    // size must be a power of two, memory::SIZE unless the profile says otherwise
+    explicit Memory(int size = memory::SIZE) noexcept;
+    // False when the file cannot be opened or read
+    bool loadProgram(const std::string& bin_path) noexcept;
+    void loadProgram(const std::vector<uint8_t>& program) noexcept;
     [[nodiscard]] uint8_t getByte(int offset) const noexcept;
+    [[nodiscard]] const memory_t& data() const noexcept { return memory_buffer; }
+    void setByte(int offset, uint8_t value) noexcept;
+    // Copies as much of the size bytes at contents as fits, callers check that the sizes match
+    void restore(const uint8_t* contents, std::size_t size) noexcept;
+
+    [[nodiscard]] int size() const noexcept { return address_mask + 1; }
+    // Every address is taken modulo the size
+    [[nodiscard]] int addressMask() const noexcept { return address_mask; }
+    [[nodiscard]] int pageCount() const noexcept { return static_cast<int>(page_generations.size()); }
+
+    // Never reallocated, so a CPU may keep the pointer and index it without going through fetch()
+    [[nodiscard]] const DecodedInstruction* predecodeTable() const noexcept { return predecode_cache.data(); }
+    void countPredecodeHit() noexcept { ++predecode_hits; }
+
+    [[nodiscard]] uint64_t predecodeHits() const noexcept { return predecode_hits; }
+    [[nodiscard]] uint64_t predecodeMisses() const noexcept { return predecode_misses; }
+    [[nodiscard]] double predecodeHitRate() const noexcept;
+
+    // Bumped on every write to the page, lets translated code detect that it went stale
+    [[nodiscard]] uint32_t pageGeneration(int page) const noexcept
+    {
+        return page_generations[page & (pageCount() - 1)];
+    }
+
+    // Bumped on every write, restore and program load, an unchanged count means memory is as it was
+    [[nodiscard]] uint64_t writeCount() const noexcept { return writes; }
+
+    // Instruction at offset, decoded once and reused until either of its bytes is written
+    [[nodiscard]] const DecodedInstruction& fetch(int offset) noexcept
+    {
+        offset &= address_mask;
+        DecodedInstruction& entry {predecode_cache[offset]};
+
+        if (entry.valid)
+        {
+            ++predecode_hits;
+            return entry;
+        }
+
+        ++predecode_misses;
+        entry.inst = {memory_buffer[offset], memory_buffer[(offset + 1) & address_mask]};
+        entry.op = opcode::TABLE[entry.inst.asWord];
+        entry.valid = true;
+        return entry;
+    }
 };
@@ -0,0 +1,266 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+
+struct Instruction
+{
+    uint32_t first_nibble : 4;
+    uint32_t second_nibble : 4;
+    uint32_t third_nibble : 4;
+    uint32_t fourth_nibble : 4;
+    uint32_t asWord : 16;
+
+    constexpr Instruction() noexcept :
+        first_nibble{},
+        second_nibble{},
+        third_nibble{},
+        fourth_nibble{},
+        asWord{}
+    {
+    }
+
+    constexpr Instruction(uint8_t first_byte, uint8_t second_byte) noexcept :
+        first_nibble {static_cast<uint32_t>(first_byte & 0xF0) >> 4},
+        second_nibble {static_cast<uint32_t>(first_byte & 0x0F)},
+        third_nibble {static_cast<uint32_t>(second_byte & 0xF0) >> 4},
+        fourth_nibble {static_cast<uint32_t>(second_byte & 0x0F)},
+        asWord {static_cast<uint32_t>((first_byte << 8) | second_byte)}
+    {
+    }
+};
+
+enum class Opcode : uint8_t
+{
+    unknown,
+    clearScreen,
+    returnFromSubroutine,
+    setProgramCounter,
+    callSubroutine,
+    skipIfEqual,
+    skipIfNotEqual,
+    skipIfRegistersEqual,
+    setRegister,
+    addToRegister,
+    assignment,
+    OR,
+    AND,
+    XOR,
+    addWithCarry,
+    subtract,
+    shiftRight,
+    shiftLeft,
+    skipIfRegistersNotEqual,
+    setIndexRegister,
+    jumpWithOffset,
+    random,
+    drawOnDisplay,
+    skipIfKeyPressed,
+    skipIfKeyNotPressed,
+    waitForKey,
+    assignDelayTimer,
+    setDelayTimer,
+    setSoundTimer,
+    storeBCD,
+    storeRegisters,
+    loadRegisters,
+    scrollDown,
+    scrollUp,
+    scrollRight,
+    scrollLeft,
+    lowResolution,
+    highResolution,
+    selectPlanes,
+    loadLongIndex,
+    count
+};
+
+// Covers every instruction set at once, a profile without the SUPER-CHIP or XO-CHIP additions runs them as unknown
+constexpr Opcode classify(uint16_t word) noexcept
+{
+    const int first_nibble {word >> 12};
+    const int fourth_nibble {word & 0x000F};
+    const int low_byte {word & 0x00FF};
+
+    switch (first_nibble)
+    {
+    case 0x0:
+        if ((word & 0xFFF0) == 0x00C0)
+            return Opcode::scrollDown;
+        if ((word & 0xFFF0) == 0x00D0)
+            return Opcode::scrollUp;
+        switch (word)
+        {
+        case 0x00E0: return Opcode::clearScreen;
+        case 0x00EE: return Opcode::returnFromSubroutine;
+        case 0x00FB: return Opcode::scrollRight;
+        case 0x00FC: return Opcode::scrollLeft;
+        case 0x00FE: return Opcode::lowResolution;
+        case 0x00FF: return Opcode::highResolution;
+        default: return Opcode::unknown;
+        }
+    case 0x1:
+        return Opcode::setProgramCounter;
+    case 0x2:
+        return Opcode::callSubroutine;
+    case 0x3:
+        return Opcode::skipIfEqual;
+    case 0x4:
+        return Opcode::skipIfNotEqual;
+    case 0x5:
+        return fourth_nibble == 0x0 ? Opcode::skipIfRegistersEqual : Opcode::unknown;
+    case 0x6:
+        return Opcode::setRegister;
+    case 0x7:
+        return Opcode::addToRegister;
+    case 0x8:
+        switch (fourth_nibble)
+        {
+        case 0x0: return Opcode::assignment;
+        case 0x1: return Opcode::OR;
+        case 0x2: return Opcode::AND;
+        case 0x3: return Opcode::XOR;
+        case 0x4: return Opcode::addWithCarry;
+        case 0x5: return Opcode::subtract;
+        case 0x6: return Opcode::shiftRight;
+        case 0xE: return Opcode::shiftLeft;
+        default: return Opcode::unknown;
+        }
+    case 0x9:
+        return fourth_nibble == 0x0 ? Opcode::skipIfRegistersNotEqual : Opcode::unknown;
+    case 0xA:
+        return Opcode::setIndexRegister;
+    case 0xB:
+        return Opcode::jumpWithOffset;
+    case 0xC:
+        return Opcode::random;
+    case 0xD:
+        return Opcode::drawOnDisplay;
+    case 0xE:
+        if (low_byte == 0x9E)
+            return Opcode::skipIfKeyPressed;
+        if (low_byte == 0xA1)
+            return Opcode::skipIfKeyNotPressed;
+        return Opcode::unknown;
+    case 0xF:
+        if (word == 0xF000)
+            return Opcode::loadLongIndex;
+        switch (low_byte)
+        {
+        case 0x01: return Opcode::selectPlanes;
+        case 0x07: return Opcode::assignDelayTimer;
+        case 0x0A: return Opcode::waitForKey;
+        case 0x15: return Opcode::setDelayTimer;
+        case 0x18: return Opcode::setSoundTimer;
+        case 0x33: return Opcode::storeBCD;
+        case 0x55: return Opcode::storeRegisters;
+        case 0x65: return Opcode::loadRegisters;
+        default: return Opcode::unknown;
+        }
+    default:
+        return Opcode::unknown;
+    }
+}
+
+namespace opcode
+{
+    constexpr std::size_t COUNT {static_cast<std::size_t>(Opcode::count)};
+
+    // Instructions that may leave the program counter anywhere but the next instruction,
+    // F000 NNNN counts as it steps over its 16-bit operand
+    constexpr bool isControlFlow(Opcode op) noexcept
+    {
+        switch (op)
+        {
+        case Opcode::returnFromSubroutine:
+        case Opcode::setProgramCounter:
+        case Opcode::callSubroutine:
+        case Opcode::skipIfEqual:
+        case Opcode::skipIfNotEqual:
+        case Opcode::skipIfRegistersEqual:
+        case Opcode::skipIfRegistersNotEqual:
+        case Opcode::jumpWithOffset:
+        case Opcode::skipIfKeyPressed:
+        case Opcode::skipIfKeyNotPressed:
+        case Opcode::waitForKey:
+        case Opcode::loadLongIndex:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Handler names indexed by Opcode, for reports and traces
+    inline constexpr std::array<std::string_view, COUNT> NAMES {
+        "unknown",
+        "clearScreen",
+        "returnFromSubroutine",
+        "setProgramCounter",
+        "callSubroutine",
+        "skipIfEqual",
+        "skipIfNotEqual",
+        "skipIfRegistersEqual",
+        "setRegister",
+        "addToRegister",
+        "assignment",
+        "OR",
+        "AND",
+        "XOR",
+        "addWithCarry",
+        "subtract",
+        "shiftRight",
+        "shiftLeft",
+        "skipIfRegistersNotEqual",
+        "setIndexRegister",
+        "jumpWithOffset",
+        "random",
+        "drawOnDisplay",
+        "skipIfKeyPressed",
+        "skipIfKeyNotPressed",
+        "waitForKey",
+        "assignDelayTimer",
+        "setDelayTimer",
+        "setSoundTimer",
+        "storeBCD",
+        "storeRegisters",
+        "loadRegisters",
+        "scrollDown",
+        "scrollUp",
+        "scrollRight",
+        "scrollLeft",
+        "lowResolution",
+        "highResolution",
+        "selectPlanes",
+        "loadLongIndex"
+    };
+
+    constexpr std::string_view name(Opcode op) noexcept
+    {
+        return static_cast<std::size_t>(op) < COUNT ? NAMES[static_cast<std::size_t>(op)] : NAMES[0];
+    }
+
+    // Instructions that write guest memory
+    constexpr bool writesMemory(Opcode op) noexcept
+    {
+        return op == Opcode::storeBCD || op == Opcode::storeRegisters;
+    }
+
+    // Every 16-bit word classified up front, so decoding is a single 64 KB lookup
+    inline constexpr std::array<Opcode, 0x10000> TABLE = []
+    {
+        std::array<Opcode, 0x10000> table {};
+        for (std::size_t word{0}; word < table.size(); ++word)
+        {
+            table[word] = classify(static_cast<uint16_t>(word));
+        }
+        return table;
+    }();
+}
+
+struct DecodedInstruction
+{
+    Instruction inst {};
+    Opcode op {Opcode::unknown};
+    bool valid {false};
+};
@@ -0,0 +1,118 @@
+#include "protocol.hpp"
+#include <bit>
+
+namespace
+{
+    template <typename T>
+    void put(std::vector<uint8_t>& out, T value) noexcept
+    {
+        for (std::size_t i{0}; i < sizeof(T); ++i)
+        {
+            out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+        }
+    }
+
+    template <typename T>
+    T get(const uint8_t* in) noexcept
+    {
+        uint64_t value {0};
+        for (std::size_t i{0}; i < sizeof(T); ++i)
+        {
+            value |= static_cast<uint64_t>(in[i]) << (i * 8);
+        }
+        return static_cast<T>(value);
+    }
+}
+
+void protocol::appendHello(std::vector<uint8_t>& out) noexcept
+{
+    put(out, HELLO);
+    put(out, MAGIC);
+    put(out, VERSION);
+}
+
+void protocol::appendFrame(std::vector<uint8_t>& out, uint64_t frame, uint8_t flags, const Framebuffer& framebuffer, dirty_rows_t rows) noexcept
+{
+    out.reserve(out.size() + FRAME_HEADER_SIZE + static_cast<std::size_t>(std::popcount(rows)) * ROW_SIZE);
+
+    put(out, FRAME);
+    put(out, frame);
+    put(out, flags);
+    put(out, rows);
+
+    for (; rows != 0; rows &= rows - 1)
+    {
+        const int y {std::countr_zero(rows)};
+        for (const display_plane_t& plane : framebuffer.planes)
+        {
+            for (const display_word_t word : plane[y])
+            {
+                put(out, word);
+            }
+        }
+    }
+}
+
+void protocol::appendKeypad(std::vector<uint8_t>& out, uint16_t keypad) noexcept
+{
+    put(out, KEYPAD);
+    put(out, keypad);
+}
+
+bool FrameDecoder::feed(std::span<const uint8_t> bytes) noexcept
+{
+    pending.insert(pending.end(), bytes.begin(), bytes.end());
+    std::size_t position {0};
+
+    while (position < pending.size())
+    {
+        const uint8_t* const message {pending.data() + position};
+        const std::size_t available {pending.size() - position};
+
+        if (message[0] == protocol::HELLO)
+        {
+            if (available < protocol::HELLO_SIZE)
+                break;
+            if (get<uint32_t>(message + 1) != protocol::MAGIC || get<uint16_t>(message + 5) != protocol::VERSION)
+                return false;
+
+            greeted = true;
+            position += protocol::HELLO_SIZE;
+            continue;
+        }
+
+        if (message[0] != protocol::FRAME || !greeted)
+            return false;
+        if (available < protocol::FRAME_HEADER_SIZE)
+            break;
+
+        dirty_rows_t rows {get<dirty_rows_t>(message + 10)};
+        const std::size_t size {protocol::FRAME_HEADER_SIZE + static_cast<std::size_t>(std::popcount(rows)) * protocol::ROW_SIZE};
+        if (available < size)
+            break;
+
+        frame = get<uint64_t>(message + 1);
+        flags = message[9];
+        framebuffer.hires = flags & protocol::FLAG_HIRES;
+
+        const uint8_t* row {message + protocol::FRAME_HEADER_SIZE};
+        for (; rows != 0; rows &= rows - 1)
+        {
+            const int y {std::countr_zero(rows)};
+            for (display_plane_t& plane : framebuffer.planes)
+            {
+                for (display_word_t& word : plane[y])
+                {
+                    word = get<display_word_t>(row);
+                    row += sizeof(display_word_t);
+                }
+            }
+        }
+
+        frames_received++;
+        position += size;
+    }
+
+    pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(position));
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "display.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// chip8-server wire format, little-endian throughout.
+// Server to client:
+//   HELLO   type, magic u32, version u16, sent once on connecting
+//   FRAME   type, frame u64, flags u8, rows u64, then for every set bit of rows, lowest first,
+//           the row from each plane as WORDS_PER_ROW u64 words. Only sent when something changed
+// Client to server:
+//   KEYPAD  type, keypad u16 with bit n set while key n is held, latched at the next frame
+namespace protocol
+{
+    constexpr uint32_t MAGIC {0x56533843}; // "C8SV"
+    constexpr uint16_t VERSION {1};
+
+    constexpr uint8_t HELLO {0x01};
+    constexpr uint8_t FRAME {0x02};
+    constexpr uint8_t KEYPAD {0x10};
+
+    constexpr uint8_t FLAG_HIRES {0x01};
+    constexpr uint8_t FLAG_SOUND {0x02};
+
+    constexpr std::size_t HELLO_SIZE {1 + 4 + 2};
+    constexpr std::size_t FRAME_HEADER_SIZE {1 + 8 + 1 + 8};
+    constexpr std::size_t ROW_SIZE {display::PLANES * display::WORDS_PER_ROW * sizeof(display_word_t)};
+    constexpr std::size_t KEYPAD_SIZE {1 + 2};
+
+    // Every row, for a client that has not seen the framebuffer yet
+    constexpr dirty_rows_t ALL_ROWS {~dirty_rows_t{0}};
+
+    void appendHello(std::vector<uint8_t>& out) noexcept;
+    void appendFrame(std::vector<uint8_t>& out, uint64_t frame, uint8_t flags, const Framebuffer& framebuffer, dirty_rows_t rows) noexcept;
+    void appendKeypad(std::vector<uint8_t>& out, uint16_t keypad) noexcept;
+}
+
+// Client side, keeps a copy of the server's framebuffer up to date from the byte stream
+class FrameDecoder
+{
+private:
+    std::vector<uint8_t> pending {};
+
+public:
+    Framebuffer framebuffer {};
+    uint64_t frame {};
+    uint8_t flags {};
+    bool greeted {false};
+    uint64_t frames_received {};
+
+    // Applies every complete message in what has arrived so far, false once the stream is malformed
+    bool feed(std::span<const uint8_t> bytes) noexcept;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include "utils.hpp"
+#include <string_view>
+
+// Index register after FX55/FX65
+enum class IndexIncrement
+{
+    pastLast, // I += X + 1, COSMAC VIP
+    byX,      // I += X, CHIP-48
+    none      // I unchanged, SUPER-CHIP
+};
+
+// Behaviour that differs between interpreters, every member is a compile time constant
+namespace quirks
+{
+    struct Cosmac
+    {
+        static constexpr bool shift_copies_vy {true};          // 8XY6/8XYE shift VY into VX
+        static constexpr bool jump_adds_vx {false};            // BXNN jumps to XNN + VX instead of BNNN + V0
+        static constexpr bool logic_resets_vf {true};          // 8XY1/8XY2/8XY3 clear VF
+        static constexpr IndexIncrement index_increment {IndexIncrement::pastLast};
+        static constexpr int memory_size {memory::SIZE};       // bytes of RAM, addresses wrap at the end
+        static constexpr bool super_chip_instructions {false}; // 00CN, 00FB, 00FC, 00FE, 00FF and DXY0 16x16 sprites
+        static constexpr bool xo_chip_instructions {false};    // 00DN, FN01, F000 NNNN, skips step over F000 NNNN whole
+    };
+
+    struct Chip48
+    {
+        static constexpr bool shift_copies_vy {false};
+        static constexpr bool jump_adds_vx {true};
+        static constexpr bool logic_resets_vf {false};
+        static constexpr IndexIncrement index_increment {IndexIncrement::byX};
+        static constexpr int memory_size {memory::SIZE};
+        static constexpr bool super_chip_instructions {false};
+        static constexpr bool xo_chip_instructions {false};
+    };
+
+    struct SuperChip
+    {
+        static constexpr bool shift_copies_vy {false};
+        static constexpr bool jump_adds_vx {true};
+        static constexpr bool logic_resets_vf {false};
+        static constexpr IndexIncrement index_increment {IndexIncrement::none};
+        static constexpr int memory_size {memory::SIZE};
+        static constexpr bool super_chip_instructions {true};
+        static constexpr bool xo_chip_instructions {false};
+    };
+
+    struct XoChip
+    {
+        static constexpr bool shift_copies_vy {true};
+        static constexpr bool jump_adds_vx {false};
+        static constexpr bool logic_resets_vf {false};
+        static constexpr IndexIncrement index_increment {IndexIncrement::pastLast};
+        static constexpr int memory_size {memory::XO_CHIP_SIZE};
+        static constexpr bool super_chip_instructions {true};
+        static constexpr bool xo_chip_instructions {true};
+    };
+}
+
+enum class Profile
+{
+    cosmac,
+    chip48,
+    superChip,
+    xoChip
+};
+
+constexpr bool parseProfile(std::string_view name, Profile& profile) noexcept
+{
+    if (name == "cosmac")
+        profile = Profile::cosmac;
+    else if (name == "chip48")
+        profile = Profile::chip48;
+    else if (name == "superchip")
+        profile = Profile::superChip;
+    else if (name == "xochip")
+        profile = Profile::xoChip;
+    else
+        return false;
+
+    return true;
+}
+
+// RAM a machine of this profile gets, so only XO-CHIP pays for 64 KB and its derived tables
+constexpr int memorySize(Profile profile) noexcept
+{
+    switch (profile)
+    {
+    case Profile::chip48: return quirks::Chip48::memory_size;
+    case Profile::superChip: return quirks::SuperChip::memory_size;
+    case Profile::xoChip: return quirks::XoChip::memory_size;
+    default: return quirks::Cosmac::memory_size;
+    }
+}
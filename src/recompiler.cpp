@@ -0,0 +1,266 @@
+#include "recompiler.hpp"
+#include "block_cache.hpp"
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    std::string hex(int value, int digits)
+    {
+        std::ostringstream out;
+        out << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+        return out.str();
+    }
+
+    std::string reg(int index)
+    {
+        return "cpu.gp_regs[" + hex(index, 1) + "]";
+    }
+
+    // Condition under which a skip instruction skips, in terms of the emitted CPU
+    std::string skipCondition(uint16_t word, Opcode op)
+    {
+        const int x {(word >> 8) & 0xF};
+        const int y {(word >> 4) & 0xF};
+        const int nn {word & 0xFF};
+
+        switch (op)
+        {
+        case Opcode::skipIfEqual: return reg(x) + " == " + hex(nn, 2);
+        case Opcode::skipIfNotEqual: return reg(x) + " != " + hex(nn, 2);
+        case Opcode::skipIfRegistersEqual: return reg(x) + " == " + reg(y);
+        case Opcode::skipIfRegistersNotEqual: return reg(x) + " != " + reg(y);
+        case Opcode::skipIfKeyPressed: return "(cpu.keypad & (1 << (" + reg(x) + " & 0xF))) != 0";
+        case Opcode::skipIfKeyNotPressed: return "(cpu.keypad & (1 << (" + reg(x) + " & 0xF))) == 0";
+        default: return "false";
+        }
+    }
+
+    bool isSkip(Opcode op)
+    {
+        return op == Opcode::skipIfEqual || op == Opcode::skipIfNotEqual || op == Opcode::skipIfRegistersEqual
+            || op == Opcode::skipIfRegistersNotEqual || op == Opcode::skipIfKeyPressed || op == Opcode::skipIfKeyNotPressed;
+    }
+}
+
+Recompiler::Recompiler(const std::vector<uint8_t>& rom) noexcept :
+    memory {std::make_unique<Memory>(memory::XO_CHIP_SIZE)},
+    rom_end {memory::PROGRAM_OFFSET + static_cast<int>(std::min<std::size_t>(rom.size(), memory::XO_CHIP_SIZE - memory::PROGRAM_OFFSET))}
+{
+    memory->loadProgram(rom);
+
+    // Every leader is found first, so the blocks can then be split at all of them
+    std::set<int> leaders {memory::PROGRAM_OFFSET};
+    std::vector<int> worklist {memory::PROGRAM_OFFSET};
+
+    while (!worklist.empty())
+    {
+        const int start {worklist.back()};
+        worklist.pop_back();
+
+        for (const int successor : scan(start, leaders, false).successors)
+        {
+            if (inRom(successor) && leaders.insert(successor).second)
+                worklist.push_back(successor);
+        }
+    }
+
+    // A block that reaches another leader falls through into it, so no code is emitted twice
+    for (const int start : leaders)
+    {
+        RecoveredBlock block {scan(start, leaders, true)};
+        if (!block.words.empty())
+            blocks[start] = std::move(block);
+    }
+}
+
+bool Recompiler::inRom(int address) const noexcept
+{
+    return address >= memory::PROGRAM_OFFSET && address + 2 <= rom_end;
+}
+
+uint16_t Recompiler::wordAt(int address) const noexcept
+{
+    return static_cast<uint16_t>((memory->getByte(address) << 8) | memory->getByte(address + 1));
+}
+
+std::vector<int> Recompiler::successorsOf(int address, Opcode op) const noexcept
+{
+    const int next {address + 2};
+    const int target {wordAt(address) & 0xFFF};
+
+    switch (op)
+    {
+    case Opcode::setProgramCounter: return {target};
+    case Opcode::callSubroutine: return {target, next};
+    case Opcode::waitForKey: return {address, next};
+    case Opcode::returnFromSubroutine: return {};
+    default:
+        if (isSkip(op))
+            return {next, next + 2};
+        return {next};
+    }
+}
+
+RecoveredBlock Recompiler::scan(int start, const std::set<int>& leaders, bool stop_at_leaders) const noexcept
+{
+    RecoveredBlock block {};
+    block.start = start;
+
+    int address {start};
+    while (static_cast<int>(block.words.size()) < block::MAX_INSTRUCTIONS && inRom(address))
+    {
+        if (stop_at_leaders && address != start && leaders.count(address))
+            break;
+
+        const uint16_t word {wordAt(address)};
+        const Opcode op {opcode::TABLE[word]};
+
+        // Left to the interpreter, BNNN jumps somewhere only known at run time, and F000 NNNN and a skip over it
+        // take four bytes or two depending on the profile the program runs under
+        if (op == Opcode::unknown || op == Opcode::jumpWithOffset || op == Opcode::loadLongIndex
+            || (isSkip(op) && wordAt(address + 2) == 0xF000))
+        {
+            block.end = address;
+            return block;
+        }
+
+        block.words.push_back(word);
+
+        if (opcode::isControlFlow(op))
+        {
+            block.end = address + 2;
+            block.successors = successorsOf(address, op);
+            return block;
+        }
+
+        address += 2;
+    }
+
+    block.end = address;
+    block.successors = {address};
+    return block;
+}
+
+int Recompiler::instructionCount() const noexcept
+{
+    int count {0};
+    for (const auto& [start, block] : blocks)
+    {
+        count += static_cast<int>(block.words.size());
+    }
+    return count;
+}
+
+void Recompiler::emitBlock(std::ostream& out, const RecoveredBlock& block) const
+{
+    out << "    int block_" << hex(block.start, 4).substr(2) << "(CPU& cpu, [[maybe_unused]] const Memory& memory) noexcept\n"
+        << "    {\n";
+
+    bool sets_pc {false};
+    for (std::size_t i{0}; i < block.words.size(); ++i)
+    {
+        const int address {block.start + static_cast<int>(i) * 2};
+        const int next {address + 2};
+        const uint16_t word {block.words[i]};
+        const Opcode op {opcode::TABLE[word]};
+        const int x {(word >> 8) & 0xF};
+        const int y {(word >> 4) & 0xF};
+
+        out << "        // " << hex(address, 3) << ": " << hex(word, 4).substr(2) << ' ' << opcode::name(op) << '\n';
+        sets_pc = opcode::isControlFlow(op);
+
+        // Straight-line register work is emitted inline, everything else goes through the CPU's own handler
+        switch (op)
+        {
+        case Opcode::setRegister:
+            out << "        " << reg(x) << " = " << hex(word & 0xFF, 2) << ";\n";
+            continue;
+        case Opcode::addToRegister:
+            out << "        " << reg(x) << " += " << hex(word & 0xFF, 2) << ";\n";
+            continue;
+        case Opcode::assignment:
+            out << "        " << reg(x) << " = " << reg(y) << ";\n";
+            continue;
+        case Opcode::addWithCarry:
+            out << "        " << "cpu.gp_regs[0xF] = " << reg(x) << " + " << reg(y) << " > 0xFF;\n"
+                << "        " << reg(x) << " += " << reg(y) << ";\n";
+            continue;
+        case Opcode::subtract:
+            out << "        " << "cpu.gp_regs[0xF] = " << reg(x) << " >= " << reg(y) << ";\n"
+                << "        " << reg(x) << " -= " << reg(y) << ";\n";
+            continue;
+        case Opcode::setIndexRegister:
+            out << "        cpu.index_reg = " << hex(word & 0xFFF, 3) << ";\n";
+            continue;
+        case Opcode::setProgramCounter:
+            out << "        cpu.program_counter = " << hex(word & 0xFFF, 3) << ";\n";
+            continue;
+        default:
+            break;
+        }
+
+        if (isSkip(op))
+        {
+            out << "        cpu.program_counter = " << skipCondition(word, op) << " ? " << hex(next + 2, 3)
+                << " : " << hex(next, 3) << ";\n";
+            continue;
+        }
+
+        out << "        cpu.program_counter = " << hex(next, 3) << ";\n"
+            << "        cpu.inst = {" << hex(word >> 8, 2) << ", " << hex(word & 0xFF, 2) << "};\n"
+            << "        cpu.decode();\n";
+
+        // A store into the rest of this block hands back to the runner, which interprets the rewritten code
+        if (opcode::writesMemory(op) && i + 1 < block.words.size())
+        {
+            out << "        if (!aot::unchanged(memory, ROM, " << hex(next, 3) << ", " << hex(block.end + 2, 3) << "))\n"
+                << "            return " << i + 1 << ";\n";
+        }
+    }
+
+    if (!sets_pc)
+        out << "        cpu.program_counter = " << hex(block.end, 3) << ";\n";
+
+    out << "        return " << block.words.size() << ";\n"
+        << "    }\n\n";
+}
+
+void Recompiler::emit(std::ostream& out, const std::string& rom_name) const
+{
+    out << "// Generated by chip8-recompile from " << rom_name << ", do not edit\n"
+        << "#include \"aot.hpp\"\n"
+        << "#include <array>\n\n"
+        << "namespace\n"
+        << "{\n"
+        << "    constexpr std::array<uint8_t, " << rom_end - memory::PROGRAM_OFFSET << "> ROM {";
+
+    for (int address{memory::PROGRAM_OFFSET}; address < rom_end; ++address)
+    {
+        if ((address - memory::PROGRAM_OFFSET) % 16 == 0)
+            out << "\n        ";
+        else
+            out << ' ';
+        out << hex(memory->getByte(address), 2) << ',';
+    }
+    out << "\n    };\n\n";
+
+    for (const auto& [start, block] : blocks)
+    {
+        emitBlock(out, block);
+    }
+
+    out << "    const std::array<AotBlock, " << blocks.size() << "> BLOCKS {{";
+    for (const auto& [start, block] : blocks)
+    {
+        out << "\n        {" << hex(block.start, 3) << ", " << hex(block.end, 3) << ", " << block.words.size()
+            << ", block_" << hex(block.start, 4).substr(2) << "},";
+    }
+    out << "\n    }};\n\n"
+        << "    const AotProgram PROGRAM {ROM, BLOCKS};\n"
+        << "}\n\n"
+        << "const AotProgram& aotProgram() noexcept\n"
+        << "{\n"
+        << "    return PROGRAM;\n"
+        << "}\n";
+}
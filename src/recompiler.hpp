@@ -0,0 +1,46 @@
+#pragma once
+#include "memory.hpp"
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// A basic block recovered from the ROM, the instructions in [start, end)
+struct RecoveredBlock
+{
+    int start {};
+    int end {};
+    std::vector<uint16_t> words {};
+    std::vector<int> successors {};
+};
+
+// Recovers the control-flow graph of a ROM statically, following jumps, calls, returns sites and both sides
+// of every skip from the entry point, and emits it as C++ with one function per basic block.
+// Blocks stop before BNNN, F000 NNNN, skips over F000 NNNN and unknown words, the interpreter runs those at
+// run time. The ROM is read into the XO-CHIP address space, the largest any profile loads
+class Recompiler
+{
+private:
+    std::unique_ptr<Memory> memory;
+    int rom_end;
+    std::map<int, RecoveredBlock> blocks {};
+
+    [[nodiscard]] bool inRom(int address) const noexcept;
+    [[nodiscard]] uint16_t wordAt(int address) const noexcept;
+    [[nodiscard]] std::vector<int> successorsOf(int address, Opcode op) const noexcept;
+
+    // Walks from a leader to the end of its block, stop_at_leaders splits blocks at known leaders
+    RecoveredBlock scan(int start, const std::set<int>& leaders, bool stop_at_leaders) const noexcept;
+    void emitBlock(std::ostream& out, const RecoveredBlock& block) const;
+
+public:
+    explicit Recompiler(const std::vector<uint8_t>& rom) noexcept;
+
+    [[nodiscard]] const std::map<int, RecoveredBlock>& recoveredBlocks() const noexcept { return blocks; }
+    [[nodiscard]] int instructionCount() const noexcept;
+
+    // A translation unit defining aotProgram(), to be linked against chip8-emulator-lib and aot_main.cpp
+    void emit(std::ostream& out, const std::string& rom_name) const;
+};
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "recompiler.hpp"
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cout << "Usage: chip8-recompile <binary file> <output .cpp>\n";
+        return -1;
+    }
+
+    std::ifstream ifs {argv[1], std::ios::binary};
+    if (!ifs)
+    {
+        std::cout << "Could not read " << argv[1] << '\n';
+        return -1;
+    }
+    const std::vector<uint8_t> rom {std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    const Recompiler recompiler {rom};
+
+    std::ofstream ofs {argv[2]};
+    recompiler.emit(ofs, std::string{argv[1]}.substr(std::string{argv[1]}.find_last_of("/\\") + 1));
+    if (!ofs)
+    {
+        std::cout << "Could not write " << argv[2] << '\n';
+        return -1;
+    }
+
+    std::cout << "Recompiled " << recompiler.recoveredBlocks().size() << " blocks, "
+              << recompiler.instructionCount() << " instructions of " << rom.size() / 2 << " words\n";
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "frame_log.hpp"
+#include <cstdint>
+#include <string>
+
+namespace recording
+{
+    constexpr uint32_t MAGIC {0x50523843}; // "C8RP"
+    constexpr uint16_t VERSION {1};
+}
+
+using InputEvent = FrameChange<uint16_t>;
+
+// Seed plus every keypad change, enough to re-run a session frame for frame
+class InputRecording
+{
+private:
+    FrameLog<uint16_t> events {};
+
+public:
+    uint32_t seed {};
+    int cycles_per_frame {};
+    uint64_t rom_hash {};
+    uint64_t frame_count {};
+
+    // Keypad state sampled at the start of a frame, only changes are stored
+    void record(uint64_t frame, uint16_t keypad) noexcept { events.record(frame, keypad); }
+
+    // Keypad state for the start of a frame, frames must be requested in increasing order
+    [[nodiscard]] uint16_t keypadAt(uint64_t frame) noexcept { return events.valueAt(frame); }
+
+    // Frame of the first change keypadAt() has not reached yet, UINT64_MAX when there is none
+    [[nodiscard]] uint64_t nextEventFrame() const noexcept { return events.nextChangeFrame(); }
+
+    [[nodiscard]] const std::vector<InputEvent>& inputEvents() const noexcept { return events.entries(); }
+
+    bool save(const std::string& path) const noexcept;
+    bool load(const std::string& path) noexcept;
+};
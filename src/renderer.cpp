@@ -0,0 +1,137 @@
+#include "renderer.hpp"
+
+void Renderer::resize(int new_width, int new_height) noexcept
+{
+    width = new_width;
+    height = new_height;
+
+    // The texture is allocated at high resolution once, low resolution uses its top left corner
+    sprite.setTextureRect({0, 0, width, height});
+    const auto scale {static_cast<float>(window::WIDTH) / width};
+    sprite.setScale({scale, scale});
+}
+
+void Renderer::expandRow(int y, const display_t& planes) noexcept
+{
+    auto out {std::begin(pixels) + y * width * BYTES_PER_PIXEL};
+
+    for (int word{0}; word < width / display::WORD_BITS; ++word)
+    {
+        const display_word_t first {planes[0][y][word]};
+        const display_word_t second {planes[1][y][word]};
+
+        for (int shift{display::WORD_BITS - 4}; shift >= 0; shift -= 4)
+        {
+            const auto& chunk {expanded_nibbles[(((second >> shift) & 0xF) << 4) | ((first >> shift) & 0xF)]};
+            out = std::copy(std::begin(chunk), std::end(chunk), out);
+        }
+    }
+}
+
+void Renderer::uploadRows(int first, int count) noexcept
+{
+    const auto offset {static_cast<std::size_t>(first) * width * BYTES_PER_PIXEL};
+    texture.update(pixels.data() + offset, width, count, 0, first);
+}
+
+Renderer::Renderer() noexcept
+{
+    for (int index{0}; index < 256; ++index)
+    {
+        for (int pixel{0}; pixel < 4; ++pixel)
+        {
+            const int bit {3 - pixel};
+            const int first {(index >> bit) & 1};
+            const int second {(index >> (4 + bit)) & 1};
+            const uint32_t color {display::PALETTE[(second << 1) | first]};
+
+            for (int channel{0}; channel < BYTES_PER_PIXEL; ++channel)
+            {
+                expanded_nibbles[index][pixel * BYTES_PER_PIXEL + channel] = (color >> (24 - channel * 8)) & 0xFF;
+            }
+        }
+    }
+
+    texture.create(display::HIRES_WIDTH, display::HIRES_HEIGHT);
+    sprite.setTexture(texture, true);
+    resize(display::WIDTH, display::HEIGHT);
+
+    const display_t blank {};
+    for (int y{0}; y < height; ++y)
+    {
+        expandRow(y, blank);
+    }
+    uploadRows(0, height);
+}
+
+void Renderer::update(const Framebuffer& frame) noexcept
+{
+    const auto start {std::chrono::steady_clock::now()};
+    dirty_rows_t dirty {};
+
+    // A resolution change repacks every row at the new width
+    const int frame_width {frame.hires ? display::HIRES_WIDTH : display::WIDTH};
+    if (frame_width != width)
+    {
+        resize(frame_width, frame.hires ? display::HIRES_HEIGHT : display::HEIGHT);
+        dirty = ~dirty_rows_t{0};
+    }
+    else
+    {
+        for (int y{0}; y < height; ++y)
+        {
+            for (int plane{0}; plane < display::PLANES; ++plane)
+            {
+                if (frame.planes[plane][y] != shown.planes[plane][y])
+                    dirty |= dirty_rows_t{1} << y;
+            }
+        }
+    }
+
+    // Contiguous runs of changed rows go up in one texture update each
+    int y {0};
+    while (y < height)
+    {
+        if (!(dirty & (dirty_rows_t{1} << y)))
+        {
+            y++;
+            continue;
+        }
+
+        const int first {y};
+        while (y < height && (dirty & (dirty_rows_t{1} << y)))
+        {
+            expandRow(y, frame.planes);
+            y++;
+        }
+
+        uploadRows(first, y - first);
+    }
+
+    shown = frame;
+
+    render_time += std::chrono::steady_clock::now() - start;
+}
+
+void Renderer::draw(sf::RenderTarget& target) noexcept
+{
+    const auto start {std::chrono::steady_clock::now()};
+    target.draw(sprite);
+
+    render_time += std::chrono::steady_clock::now() - start;
+    rendered_frames++;
+}
+
+double Renderer::averageFrameMicroseconds() const noexcept
+{
+    if (rendered_frames == 0)
+        return 0.0;
+
+    return std::chrono::duration<double, std::micro>{render_time}.count() / rendered_frames;
+}
+
+void Renderer::resetFrameTime() noexcept
+{
+    render_time = {};
+    rendered_frames = 0;
+}
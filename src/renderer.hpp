@@ -0,0 +1,42 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include "display.hpp"
+
+// Expands the framebuffer into an RGBA texture and presents it as one scaled sprite
+class Renderer
+{
+private:
+    static constexpr int BYTES_PER_PIXEL {4};
+
+    // RGBA bytes for four pixels, indexed by (plane 2 nibble << 4) | plane 1 nibble
+    std::array<std::array<sf::Uint8, 4 * BYTES_PER_PIXEL>, 256> expanded_nibbles {};
+
+    // Rows are packed at the current resolution's width
+    std::array<sf::Uint8, display::HIRES_WIDTH * display::HIRES_HEIGHT * BYTES_PER_PIXEL> pixels {};
+    sf::Texture texture {};
+    sf::Sprite sprite {};
+    int width {};
+    int height {};
+
+    // What the texture currently holds, frames arrive from another thread so changed rows are found by comparison
+    Framebuffer shown {};
+
+    std::chrono::nanoseconds render_time {};
+    int rendered_frames {};
+
+    void resize(int new_width, int new_height) noexcept;
+    void expandRow(int y, const display_t& planes) noexcept;
+    void uploadRows(int first, int count) noexcept;
+
+public:
+    Renderer() noexcept;
+
+    // Re-expands and uploads only the rows that differ from the last frame shown
+    void update(const Framebuffer& frame) noexcept;
+    void draw(sf::RenderTarget& target) noexcept;
+
+    // CPU time spent in update() and draw() per presented frame since the last reset
+    [[nodiscard]] double averageFrameMicroseconds() const noexcept;
+    void resetFrameTime() noexcept;
+};
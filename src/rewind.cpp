@@ -0,0 +1,272 @@
+#include "rewind.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Visits every field of the registers and display in packing order. Going field by field
+    // keeps struct padding, whose bytes are unspecified, out of the XOR deltas
+    template <typename Cpu, typename Frame, typename Visit>
+    constexpr void forEachField(Cpu& cpu, Frame& framebuffer, Visit visit) noexcept
+    {
+        visit(cpu.gp_regs);
+        visit(cpu.program_counter);
+        visit(cpu.index_reg);
+        visit(cpu.cpu_stack.entries);
+        visit(cpu.cpu_stack.depth);
+        visit(cpu.delay_timer);
+        visit(cpu.sound_timer);
+        visit(cpu.keypad);
+        visit(cpu.rng.state);
+        visit(framebuffer.planes);
+        visit(framebuffer.hires);
+        visit(framebuffer.plane_mask);
+    }
+
+    // Registers and display ahead of RAM in a packed state
+    constexpr std::size_t FIXED_BYTES {[]
+    {
+        CpuState cpu {};
+        Framebuffer framebuffer {};
+        std::size_t bytes {0};
+        forEachField(cpu, framebuffer, [&bytes](const auto& field) { bytes += sizeof(field); });
+        return bytes;
+    }()};
+
+    void pack(const MachineState& state, std::vector<uint8_t>& image) noexcept
+    {
+        image.resize(FIXED_BYTES + state.ram_size);
+        uint8_t* out {image.data()};
+        forEachField(state.cpu, state.framebuffer, [&out](const auto& field)
+        {
+            std::memcpy(out, &field, sizeof(field));
+            out += sizeof(field);
+        });
+        std::memcpy(out, state.ram.data(), state.ram_size);
+    }
+
+    void unpack(const std::vector<uint8_t>& image, MachineState& state) noexcept
+    {
+        const uint8_t* in {image.data()};
+        forEachField(state.cpu, state.framebuffer, [&in](auto& field)
+        {
+            std::memcpy(&field, in, sizeof(field));
+            in += sizeof(field);
+        });
+        state.ram_size = static_cast<uint32_t>(image.size() - FIXED_BYTES);
+        std::memcpy(state.ram.data(), in, state.ram_size);
+    }
+
+    // LEB128, seven bits per byte, short runs cost a single byte
+    void writeLength(std::vector<uint8_t>& out, std::size_t length) noexcept
+    {
+        while (length >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(length | 0x80));
+            length >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(length));
+    }
+
+    std::size_t readLength(const std::vector<uint8_t>& in, std::size_t& i) noexcept
+    {
+        std::size_t length {0};
+        for (int shift{0}; i < in.size(); shift += 7)
+        {
+            const uint8_t byte {in[i++]};
+            length |= static_cast<std::size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        return length;
+    }
+
+    // Pairs of (unchanged bytes, changed bytes) lengths, each followed by the XOR of the changed bytes
+    std::vector<uint8_t> encode(const uint8_t* base, const uint8_t* state, std::size_t size) noexcept
+    {
+        std::vector<uint8_t> out {};
+        std::size_t i {0};
+
+        while (i < size)
+        {
+            // Most of the state is unchanged between frames, so skip it a word at a time
+            const std::size_t zero_start {i};
+            while (i + 8 <= size && std::memcmp(base + i, state + i, 8) == 0)
+                i += 8;
+            while (i < size && base[i] == state[i])
+                i++;
+
+            if (i == size)
+                break;
+
+            // A literal run swallows short unchanged gaps, they cost less than a new run header
+            const std::size_t literal_start {i};
+            std::size_t literal_end {i};
+            while (i < size)
+            {
+                if (base[i] != state[i])
+                {
+                    literal_end = ++i;
+                    continue;
+                }
+
+                std::size_t gap {i};
+                while (gap < size && base[gap] == state[gap] && gap - i < history::MIN_ZERO_RUN)
+                    gap++;
+
+                if (gap - i == history::MIN_ZERO_RUN || gap == size)
+                    break;
+
+                i = gap;
+            }
+
+            writeLength(out, literal_start - zero_start);
+            writeLength(out, literal_end - literal_start);
+            for (std::size_t j{literal_start}; j < literal_end; ++j)
+            {
+                out.push_back(base[j] ^ state[j]);
+            }
+            i = literal_end;
+        }
+
+        return out;
+    }
+
+    void apply(const std::vector<uint8_t>& delta, uint8_t* state) noexcept
+    {
+        std::size_t offset {0};
+        std::size_t i {0};
+
+        while (i < delta.size())
+        {
+            offset += readLength(delta, i);
+            const std::size_t literal {readLength(delta, i)};
+
+            for (std::size_t j{0}; j < literal; ++j)
+            {
+                state[offset++] ^= delta[i++];
+            }
+        }
+    }
+}
+
+RewindBuffer::RewindBuffer(std::size_t capacity, int keyframe_interval) noexcept :
+    capacity {capacity},
+    keyframe_interval {std::max(keyframe_interval, 1)}
+{
+}
+
+void RewindBuffer::push(uint64_t frame, const MachineState& state) noexcept
+{
+    pack(state, current);
+    if (current.size() != previous.size())
+    {
+        clear();
+        zero.assign(current.size(), 0);
+    }
+
+    const bool keyframe {entries.empty() || force_keyframe || since_keyframe >= keyframe_interval};
+    RewindEntry entry {frame, keyframe, encode(keyframe ? zero.data() : previous.data(), current.data(), current.size())};
+    stored_bytes += sizeof(RewindEntry) + entry.delta.size();
+    entries.push_back(std::move(entry));
+
+    std::swap(previous, current);
+    since_keyframe = keyframe ? 1 : since_keyframe + 1;
+    force_keyframe = false;
+
+    evict();
+}
+
+void RewindBuffer::evict() noexcept
+{
+    while (stored_bytes > capacity)
+    {
+        // A delta is useless without its keyframe, so whole groups go at once
+        const auto next_keyframe {std::find_if(entries.begin() + 1, entries.end(), [](const RewindEntry& entry)
+        {
+            return entry.keyframe;
+        })};
+
+        if (next_keyframe == entries.end())
+        {
+            // A single group over capacity starts a new one so it can be dropped on the next push
+            force_keyframe = true;
+            return;
+        }
+
+        for (auto it {entries.begin()}; it != next_keyframe; ++it)
+        {
+            stored_bytes -= sizeof(RewindEntry) + it->delta.size();
+        }
+        entries.erase(entries.begin(), next_keyframe);
+    }
+}
+
+bool RewindBuffer::seekImage(uint64_t frame, std::vector<uint8_t>& image) const noexcept
+{
+    if (entries.empty() || frame < entries.front().frame)
+        return false;
+
+    const auto last {std::upper_bound(entries.begin(), entries.end(), frame, [](uint64_t target, const RewindEntry& entry)
+    {
+        return target < entry.frame;
+    })};
+
+    auto first {last - 1};
+    while (!first->keyframe)
+        --first;
+
+    image = zero;
+    for (auto it {first}; it != last; ++it)
+    {
+        apply(it->delta, image.data());
+    }
+
+    return true;
+}
+
+bool RewindBuffer::seek(uint64_t frame, MachineState& state) const noexcept
+{
+    std::vector<uint8_t> image {};
+    if (!seekImage(frame, image))
+        return false;
+
+    unpack(image, state);
+    return true;
+}
+
+bool RewindBuffer::rewindTo(uint64_t frame, MachineState& state) noexcept
+{
+    if (!seekImage(frame, previous))
+        return false;
+
+    unpack(previous, state);
+    while (entries.back().frame > frame)
+    {
+        stored_bytes -= sizeof(RewindEntry) + entries.back().delta.size();
+        entries.pop_back();
+    }
+
+    since_keyframe = 0;
+    for (auto it {entries.rbegin()}; it != entries.rend(); ++it)
+    {
+        since_keyframe++;
+        if (it->keyframe)
+            break;
+    }
+
+    return true;
+}
+
+void RewindBuffer::clear() noexcept
+{
+    entries.clear();
+    stored_bytes = 0;
+    since_keyframe = 0;
+    force_keyframe = false;
+}
+
+double RewindBuffer::bytesPerFrame() const noexcept
+{
+    return entries.empty() ? 0.0 : static_cast<double>(stored_bytes) / entries.size();
+}
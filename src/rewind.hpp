@@ -0,0 +1,63 @@
+#pragma once
+#include "machine_state.hpp"
+#include <deque>
+#include <vector>
+
+namespace history
+{
+    constexpr int KEYFRAME_INTERVAL {60};
+    constexpr std::size_t DEFAULT_CAPACITY {16 * 1024 * 1024};
+
+    // Runs of this many unchanged bytes end a literal run in a delta
+    constexpr std::size_t MIN_ZERO_RUN {4};
+}
+
+// One stored frame, a keyframe is a delta against the all-zero state
+struct RewindEntry
+{
+    uint64_t frame {};
+    bool keyframe {};
+    std::vector<uint8_t> delta {};
+};
+
+// Bounded history of machine states, stored as periodic keyframes plus XOR/RLE deltas of the previous frame
+class RewindBuffer
+{
+private:
+    std::deque<RewindEntry> entries {};
+
+    // States packed as the bytes deltas are taken over, all the same size within one history
+    std::vector<uint8_t> previous {};
+    std::vector<uint8_t> current {};
+    std::vector<uint8_t> zero {};
+    std::size_t capacity;
+    int keyframe_interval;
+    int since_keyframe {};
+    bool force_keyframe {};
+    std::size_t stored_bytes {};
+
+    void evict() noexcept;
+    [[nodiscard]] bool seekImage(uint64_t frame, std::vector<uint8_t>& image) const noexcept;
+
+public:
+    explicit RewindBuffer(std::size_t capacity = history::DEFAULT_CAPACITY, int keyframe_interval = history::KEYFRAME_INTERVAL) noexcept;
+
+    // Frames must be pushed in increasing order, the oldest keyframe group is dropped once over capacity.
+    // A state with a different RAM size belongs to another machine and starts the history over
+    void push(uint64_t frame, const MachineState& state) noexcept;
+
+    // Rebuilds the latest stored state at or before frame
+    [[nodiscard]] bool seek(uint64_t frame, MachineState& state) const noexcept;
+
+    // Seeks and discards everything after the frame, so pushing resumes from there
+    bool rewindTo(uint64_t frame, MachineState& state) noexcept;
+
+    void clear() noexcept;
+
+    [[nodiscard]] bool empty() const noexcept { return entries.empty(); }
+    [[nodiscard]] std::size_t size() const noexcept { return entries.size(); }
+    [[nodiscard]] uint64_t oldestFrame() const noexcept { return entries.empty() ? 0 : entries.front().frame; }
+    [[nodiscard]] uint64_t newestFrame() const noexcept { return entries.empty() ? 0 : entries.back().frame; }
+    [[nodiscard]] std::size_t storedBytes() const noexcept { return stored_bytes; }
+    [[nodiscard]] double bytesPerFrame() const noexcept;
+};
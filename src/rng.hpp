@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+// xorshift32, four bytes of state that live in the machine state and make CXNN reproducible
+struct Rng
+{
+    static constexpr uint32_t DEFAULT_STATE {0x2545F491};
+
+    uint32_t state {DEFAULT_STATE};
+
+    constexpr void seed(uint32_t value) noexcept
+    {
+        // Scrambled so neighbouring seeds diverge at once, a zero state would stay zero forever
+        value ^= value >> 16;
+        value *= 0x7FEB352D;
+        value ^= value >> 15;
+        value *= 0x846CA68B;
+        value ^= value >> 16;
+        state = value ? value : DEFAULT_STATE;
+    }
+
+    constexpr uint8_t next() noexcept
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<uint8_t>(state >> 24);
+    }
+
+    constexpr bool operator==(const Rng&) const noexcept = default;
+};
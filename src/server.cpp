@@ -0,0 +1,335 @@
+#include "server.hpp"
+#include "protocol.hpp"
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr int LISTEN_BACKLOG {64};
+    constexpr std::size_t READ_CHUNK {4096};
+
+    bool addToEpoll(int epoll_fd, int fd, uint32_t events) noexcept
+    {
+        epoll_event event {};
+        event.events = events;
+        event.data.fd = fd;
+        return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+}
+
+Server::Server(const std::vector<uint8_t>& rom, const ServerOptions& options) noexcept :
+    rom {rom},
+    options {options}
+{
+}
+
+Server::~Server()
+{
+    for (const auto& [fd, session] : sessions)
+    {
+        close(fd);
+    }
+
+    for (const int fd : {listen_fd, epoll_fd, timer_fd, wake_fd})
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    if (!unix_path.empty())
+        unlink(unix_path.c_str());
+}
+
+bool Server::setUp() noexcept
+{
+    if (listen(listen_fd, LISTEN_BACKLOG) != 0)
+        return false;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0 || wake_fd < 0)
+        return false;
+
+    // Periodic, a tick that finds several expirations runs one frame and resynchronises rather than catch up
+    itimerspec period {};
+    period.it_interval.tv_nsec = timer::FRAME_DURATION.count();
+    period.it_value.tv_nsec = timer::FRAME_DURATION.count();
+    if (timerfd_settime(timer_fd, 0, &period, nullptr) != 0)
+        return false;
+
+    if (!addToEpoll(epoll_fd, listen_fd, EPOLLIN) || !addToEpoll(epoll_fd, timer_fd, EPOLLIN) || !addToEpoll(epoll_fd, wake_fd, EPOLLIN))
+        return false;
+
+    // Set here rather than in run(), so a stop() that comes first still wins
+    running.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool Server::listenUnix(const std::string& path) noexcept
+{
+    sockaddr_un address {};
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path.c_str());
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        return false;
+
+    unix_path = path;
+    return setUp();
+}
+
+bool Server::listenTcp(uint16_t port) noexcept
+{
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    const int reuse {1};
+    if (listen_fd < 0 || setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+        || bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        return false;
+
+    return setUp();
+}
+
+uint16_t Server::port() const noexcept
+{
+    sockaddr_in address {};
+    socklen_t length {sizeof(address)};
+    if (getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &length) != 0 || address.sin_family != AF_INET)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+void Server::acceptSessions() noexcept
+{
+    while (true)
+    {
+        const int fd {accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+        if (fd < 0)
+            return;
+
+        if (sessions.size() >= options.max_sessions || !addToEpoll(epoll_fd, fd, EPOLLIN | EPOLLRDHUP))
+        {
+            close(fd);
+            continue;
+        }
+
+        auto session {std::make_unique<ServerSession>()};
+        session->fd = fd;
+        session->memory = std::make_unique<Memory>(memorySize(options.profile));
+        session->memory->loadProgram(rom);
+        session->cpu = makeCPU(options.profile, session->memory.get());
+        session->cpu->backend = options.backend;
+        session->cpu->seed(options.seed);
+
+        // The whole framebuffer goes out with the first tick
+        protocol::appendHello(session->output);
+        sessions.emplace(fd, std::move(session));
+    }
+}
+
+void Server::closeSession(int fd) noexcept
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    sessions.erase(fd);
+}
+
+bool Server::readInput(ServerSession& session) noexcept
+{
+    uint8_t buffer[READ_CHUNK];
+
+    while (true)
+    {
+        const ssize_t received {recv(session.fd, buffer, sizeof(buffer), 0)};
+        if (received == 0)
+            return false;
+        if (received < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+            break;
+        }
+
+        session.input.insert(session.input.end(), buffer, buffer + received);
+    }
+
+    // Only the latest keypad state matters, it is latched at the next frame
+    std::size_t position {0};
+    for (; session.input.size() - position >= protocol::KEYPAD_SIZE; position += protocol::KEYPAD_SIZE)
+    {
+        if (session.input[position] != protocol::KEYPAD)
+            return false;
+        session.keypad = static_cast<uint16_t>(session.input[position + 1] | (session.input[position + 2] << 8));
+    }
+    if (position < session.input.size() && session.input[position] != protocol::KEYPAD)
+        return false;
+
+    session.input.erase(session.input.begin(), session.input.begin() + static_cast<std::ptrdiff_t>(position));
+    return true;
+}
+
+void Server::watchWritable(ServerSession& session, bool watch) noexcept
+{
+    if (session.writable_wait == watch)
+        return;
+
+    epoll_event event {};
+    event.events = EPOLLIN | EPOLLRDHUP | (watch ? EPOLLOUT : 0u);
+    event.data.fd = session.fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session.fd, &event);
+    session.writable_wait = watch;
+}
+
+bool Server::flush(ServerSession& session) noexcept
+{
+    while (session.sent < session.output.size())
+    {
+        const ssize_t written {send(session.fd, session.output.data() + session.sent, session.output.size() - session.sent, MSG_NOSIGNAL)};
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+
+            // The socket buffer is full, epoll says when the client has read some of it
+            watchWritable(session, true);
+            return true;
+        }
+
+        session.sent += static_cast<std::size_t>(written);
+        bytes_sent += static_cast<uint64_t>(written);
+    }
+
+    session.output.clear();
+    session.sent = 0;
+    watchWritable(session, false);
+    return true;
+}
+
+void Server::stepSessions() noexcept
+{
+    std::vector<int> closed {};
+
+    for (auto& [fd, session] : sessions)
+    {
+        CPU& cpu {*session->cpu};
+        cpu.keypad = session->keypad;
+        if (cpu.isHalted())
+        {
+            cpu.skipHaltedFrames(1, options.cycles_per_frame);
+            cpu.endFrame();
+        }
+        else
+            cpu.runFrame(options.cycles_per_frame);
+
+        // Rows are taken every frame, so a resync after a backlog starts from a clean slate
+        const dirty_rows_t rows {cpu.display.takeDirtyRows()};
+        const uint8_t flags {static_cast<uint8_t>((cpu.display.isHires() ? protocol::FLAG_HIRES : 0) | (cpu.isSoundActive() ? protocol::FLAG_SOUND : 0))};
+
+        if (session->output.size() - session->sent > server::MAX_PENDING_BYTES)
+        {
+            if (!session->resync)
+                resyncs++;
+            session->resync = true;
+        }
+        else if (session->resync)
+        {
+            protocol::appendFrame(session->output, session->frame, flags, cpu.display.state(), protocol::ALL_ROWS);
+            session->resync = false;
+            session->sent_flags = flags;
+        }
+        else if (rows != 0 || flags != session->sent_flags)
+        {
+            protocol::appendFrame(session->output, session->frame, flags, cpu.display.state(), rows);
+            session->sent_flags = flags;
+        }
+        session->frame++;
+
+        // One write per session per tick, with everything queued for it
+        if (!session->writable_wait && !flush(*session))
+            closed.push_back(fd);
+    }
+
+    for (const int fd : closed)
+    {
+        closeSession(fd);
+    }
+}
+
+void Server::run() noexcept
+{
+    epoll_event events[server::MAX_EVENTS];
+
+    while (running.load(std::memory_order_relaxed))
+    {
+        const int count {epoll_wait(epoll_fd, events, server::MAX_EVENTS, -1)};
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i{0}; i < count; ++i)
+        {
+            const int fd {events[i].data.fd};
+            uint64_t expirations {};
+
+            if (fd == listen_fd)
+                acceptSessions();
+            else if (fd == timer_fd)
+            {
+                if (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+                {
+                    stepSessions();
+                    ticks++;
+                }
+            }
+            else if (fd == wake_fd)
+                static_cast<void>(read(wake_fd, &expirations, sizeof(expirations)));
+            else
+            {
+                // A session closed earlier in this batch has nothing left to handle
+                const auto found {sessions.find(fd)};
+                if (found == sessions.end())
+                    continue;
+
+                ServerSession& session {*found->second};
+                const bool alive {(!(events[i].events & EPOLLIN) || readInput(session))
+                                  && (!(events[i].events & EPOLLOUT) || flush(session))
+                                  && !(events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))};
+                if (!alive)
+                    closeSession(fd);
+            }
+        }
+    }
+}
+
+void Server::stop() noexcept
+{
+    running.store(false, std::memory_order_relaxed);
+
+    const uint64_t wake {1};
+    if (wake_fd >= 0)
+        static_cast<void>(write(wake_fd, &wake, sizeof(wake)));
+}
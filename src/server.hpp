@@ -0,0 +1,95 @@
+#pragma once
+#include "cpu.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace server
+{
+    constexpr std::size_t MAX_SESSIONS {256};
+
+    // Unsent bytes a session may hold, past this a slow client gets one full frame once it catches up
+    // instead of a growing queue of deltas
+    constexpr std::size_t MAX_PENDING_BYTES {64 * 1024};
+
+    // Events taken from epoll per wakeup
+    constexpr int MAX_EVENTS {64};
+}
+
+struct ServerOptions
+{
+    Backend backend {Backend::interpreter};
+    Profile profile {Profile::cosmac};
+    int cycles_per_frame {timer::CYCLES_PER_FRAME};
+    uint32_t seed {};
+    std::size_t max_sessions {server::MAX_SESSIONS};
+};
+
+// One client and the machine it is watching
+struct ServerSession
+{
+    int fd {-1};
+    std::unique_ptr<Memory> memory {};
+    std::unique_ptr<CPU> cpu {};
+    uint16_t keypad {};
+    uint64_t frame {};
+    uint8_t sent_flags {};
+    bool resync {true};
+    bool writable_wait {false};
+    std::vector<uint8_t> input {};
+    std::vector<uint8_t> output {};
+    std::size_t sent {};
+};
+
+// Runs one machine per connected client on a UNIX-domain or loopback TCP socket, all from one
+// epoll loop on the calling thread. Every 60 Hz tick steps each machine one frame and queues only the
+// rows that changed, then flushes each session with a single write. See protocol.hpp for the format
+class Server
+{
+private:
+    std::vector<uint8_t> rom;
+    ServerOptions options;
+    int listen_fd {-1};
+    int epoll_fd {-1};
+    int timer_fd {-1};
+    int wake_fd {-1};
+    std::string unix_path {};
+    std::unordered_map<int, std::unique_ptr<ServerSession>> sessions {};
+    std::atomic<bool> running {false};
+    uint64_t ticks {};
+    uint64_t bytes_sent {};
+    uint64_t resyncs {};
+
+    bool setUp() noexcept;
+    void acceptSessions() noexcept;
+    void closeSession(int fd) noexcept;
+    // False when the client went away or broke the protocol
+    bool readInput(ServerSession& session) noexcept;
+    bool flush(ServerSession& session) noexcept;
+    void watchWritable(ServerSession& session, bool watch) noexcept;
+    void stepSessions() noexcept;
+
+public:
+    Server(const std::vector<uint8_t>& rom, const ServerOptions& options) noexcept;
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    bool listenUnix(const std::string& path) noexcept;
+    // Binds to 127.0.0.1 only, port 0 picks a free one
+    bool listenTcp(uint16_t port) noexcept;
+    [[nodiscard]] uint16_t port() const noexcept;
+
+    // Serves until stop()
+    void run() noexcept;
+    // Safe from any thread and from a signal handler
+    void stop() noexcept;
+
+    [[nodiscard]] std::size_t sessionCount() const noexcept { return sessions.size(); }
+    [[nodiscard]] uint64_t ticksRun() const noexcept { return ticks; }
+    [[nodiscard]] uint64_t bytesSent() const noexcept { return bytes_sent; }
+    [[nodiscard]] uint64_t resyncCount() const noexcept { return resyncs; }
+};
@@ -0,0 +1,104 @@
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "server.hpp"
+
+namespace
+{
+    Server* active_server {nullptr};
+
+    void printUsage()
+    {
+        std::cout << "Usage: chip8-server <binary file> --listen unix:<path>|tcp:<port>\n"
+                  << "                    [--cycles-per-frame N] [--block-cache] [--seed N]\n"
+                  << "                    [--profile cosmac|chip48|superchip|xochip] [--max-sessions N]\n"
+                  << "       Every client gets its own machine running the binary, tcp listens on 127.0.0.1 only\n";
+    }
+
+    void handleSignal(int)
+    {
+        if (active_server)
+            active_server->stop();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string bin_path {};
+    std::string listen_address {};
+    ServerOptions options {};
+
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string arg {argv[i]};
+        const bool has_value {i + 1 < argc};
+
+        if (arg == "--listen" && has_value)
+            listen_address = argv[++i];
+        else if (arg == "--cycles-per-frame" && has_value)
+            options.cycles_per_frame = std::stoi(argv[++i]);
+        else if (arg == "--block-cache")
+            options.backend = Backend::blockCache;
+        else if (arg == "--profile" && has_value && parseProfile(argv[i + 1], options.profile))
+            ++i;
+        else if (arg == "--seed" && has_value)
+            options.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--max-sessions" && has_value)
+            options.max_sessions = std::stoull(argv[++i]);
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage();
+            return -1;
+        }
+        else
+            bin_path = arg;
+    }
+
+    if (bin_path.empty() || listen_address.empty() || options.cycles_per_frame <= 0)
+    {
+        printUsage();
+        return -1;
+    }
+
+    std::ifstream file {bin_path, std::ios::binary};
+    if (!file)
+    {
+        std::cout << "Could not read binary file " << bin_path << '\n';
+        return -1;
+    }
+    const std::vector<uint8_t> rom {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+    Server server {rom, options};
+    bool listening {false};
+    if (listen_address.rfind("unix:", 0) == 0)
+        listening = server.listenUnix(listen_address.substr(5));
+    else if (listen_address.rfind("tcp:", 0) == 0)
+        listening = server.listenTcp(static_cast<uint16_t>(std::stoi(listen_address.substr(4))));
+    else
+    {
+        printUsage();
+        return -1;
+    }
+
+    if (!listening)
+    {
+        std::cout << "Could not listen on " << listen_address << '\n';
+        return -1;
+    }
+
+    active_server = &server;
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    std::cout << "Serving " << bin_path << " on " << listen_address << '\n';
+    server.run();
+    active_server = nullptr;
+
+    std::cout << "ticks:       " << server.ticksRun() << '\n'
+              << "bytes sent:  " << server.bytesSent() << '\n'
+              << "resyncs:     " << server.resyncCount() << '\n';
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "trace.hpp"
+#include "binary_io.hpp"
+#include <bit>
+#include <chrono>
+
+namespace
+{
+    // How long the writer sleeps when every ring was empty
+    constexpr std::chrono::microseconds WRITER_IDLE {500};
+
+    void writeRecords(std::ofstream& file, std::span<const TraceRecord> records) noexcept
+    {
+        if constexpr (std::endian::native == std::endian::little)
+        {
+            file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size_bytes()));
+        }
+        else
+        {
+            for (const TraceRecord& record : records)
+            {
+                binary_io::write(file, record.pc);
+                binary_io::write(file, record.word);
+                binary_io::write(file, record.index);
+                binary_io::write(file, record.reg);
+                binary_io::write(file, record.value);
+            }
+        }
+    }
+}
+
+TraceBuffer::TraceBuffer(uint32_t stream, std::size_t capacity) noexcept :
+    records {std::make_unique<TraceRecord[]>(std::bit_ceil(capacity))},
+    mask {std::bit_ceil(capacity) - 1},
+    stream_id {stream}
+{
+}
+
+std::span<const TraceRecord> TraceBuffer::readable() const noexcept
+{
+    const uint64_t first {head.load(std::memory_order_relaxed)};
+    const uint64_t last {tail.load(std::memory_order_acquire)};
+    const std::size_t offset {static_cast<std::size_t>(first & mask)};
+    const std::size_t count {std::min<std::size_t>(last - first, mask + 1 - offset)};
+
+    return {records.get() + offset, count};
+}
+
+void TraceBuffer::release(std::size_t count) noexcept
+{
+    head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
+TraceRecorder::TraceRecorder(const std::string& path, std::size_t capacity) noexcept :
+    file {path, std::ios::binary},
+    capacity {capacity}
+{
+    if (!file)
+        return;
+
+    binary_io::write(file, trace::MAGIC);
+    binary_io::write(file, trace::VERSION);
+    binary_io::write(file, static_cast<uint16_t>(sizeof(TraceRecord)));
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+TraceBuffer& TraceRecorder::addStream() noexcept
+{
+    const std::lock_guard lock {buffers_mutex};
+    buffers.push_back(std::make_unique<TraceBuffer>(static_cast<uint32_t>(buffers.size()), capacity));
+    return *buffers.back();
+}
+
+bool TraceRecorder::drain() noexcept
+{
+    const std::lock_guard lock {buffers_mutex};
+    bool any {false};
+
+    for (const auto& buffer : buffers)
+    {
+        // Twice, the second pass picks up the part that wrapped round to the start of the ring
+        for (int pass{0}; pass < 2; ++pass)
+        {
+            const std::span<const TraceRecord> records {buffer->readable()};
+            if (records.empty())
+                break;
+
+            binary_io::write(file, buffer->stream());
+            binary_io::write(file, static_cast<uint32_t>(records.size()));
+            writeRecords(file, records);
+
+            buffer->release(records.size());
+            written += records.size();
+            any = true;
+        }
+    }
+
+    return any;
+}
+
+void TraceRecorder::writeLoop() noexcept
+{
+    while (running.load(std::memory_order_acquire))
+    {
+        if (!drain())
+            std::this_thread::sleep_for(WRITER_IDLE);
+    }
+
+    // Producers have stopped, whatever is left is the tail of the trace
+    while (drain())
+    {
+    }
+    file.flush();
+}
+
+void TraceRecorder::start() noexcept
+{
+    if (!file || running.exchange(true))
+        return;
+
+    writer = std::thread {&TraceRecorder::writeLoop, this};
+}
+
+void TraceRecorder::stop() noexcept
+{
+    if (!running.exchange(false))
+        return;
+
+    writer.join();
+}
+
+uint64_t TraceRecorder::stallCount() noexcept
+{
+    const std::lock_guard lock {buffers_mutex};
+    uint64_t stalls {0};
+    for (const auto& buffer : buffers)
+    {
+        stalls += buffer->stallCount();
+    }
+    return stalls;
+}
+
+TraceReader::TraceReader(const std::string& path) noexcept :
+    file {path, std::ios::binary}
+{
+    uint32_t magic {};
+    uint16_t version {};
+    uint16_t record_size {};
+    valid = binary_io::read(file, magic) && magic == trace::MAGIC
+         && binary_io::read(file, version) && version == trace::VERSION
+         && binary_io::read(file, record_size) && record_size == sizeof(TraceRecord);
+}
+
+bool TraceReader::next(uint32_t& stream, TraceRecord& record) noexcept
+{
+    if (!valid)
+        return false;
+
+    while (chunk_remaining == 0)
+    {
+        if (!binary_io::read(file, chunk_stream) || !binary_io::read(file, chunk_remaining))
+            return false;
+    }
+
+    if (!binary_io::read(file, record.pc) || !binary_io::read(file, record.word) || !binary_io::read(file, record.index)
+        || !binary_io::read(file, record.reg) || !binary_io::read(file, record.value))
+        return false;
+
+    chunk_remaining--;
+    stream = chunk_stream;
+    return true;
+}
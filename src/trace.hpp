@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace trace
+{
+    constexpr uint32_t MAGIC {0x52543843}; // "C8TR"
+    constexpr uint16_t VERSION {1};
+
+    // Records per producer ring, 8 MB, about 20 ms of uncapped execution
+    constexpr std::size_t DEFAULT_CAPACITY {1 << 20};
+
+    // TraceRecord::reg when the instruction left every register as it was
+    constexpr uint8_t NO_REGISTER {0xFF};
+    // Set in TraceRecord::reg when VF changed alongside the recorded register
+    constexpr uint8_t FLAG_CHANGED {0x10};
+}
+
+// One executed instruction, 8 bytes so a ring holds a lot of history and the file stays compact
+struct TraceRecord
+{
+    uint16_t pc {};
+    uint16_t word {};
+    uint16_t index {}; // I after the instruction
+    uint8_t reg {trace::NO_REGISTER}; // low nibble is the first changed register, VF only if nothing else changed
+    uint8_t value {}; // its new value
+
+    constexpr bool operator==(const TraceRecord&) const noexcept = default;
+};
+
+static_assert(sizeof(TraceRecord) == 8, "trace records are written to file as is");
+
+// Single-producer single-consumer ring of records, the producer is the thread running the CPU
+// and the consumer is the recorder's writer thread. A full ring makes the producer wait
+// rather than drop records, a trace with holes is no use for finding divergences
+class TraceBuffer
+{
+private:
+    std::unique_ptr<TraceRecord[]> records;
+    std::size_t mask;
+    uint32_t stream_id;
+
+    alignas(64) std::atomic<uint64_t> head {};
+    alignas(64) std::atomic<uint64_t> tail {};
+    // Producer's last view of head, so a push only touches the consumer's cache line when the ring looks full
+    alignas(64) uint64_t cached_head {};
+    uint64_t stalls {};
+
+public:
+    // capacity is rounded up to a power of two
+    TraceBuffer(uint32_t stream, std::size_t capacity) noexcept;
+
+    void push(const TraceRecord& record) noexcept
+    {
+        const uint64_t position {tail.load(std::memory_order_relaxed)};
+        if (position - cached_head > mask)
+        {
+            while (position - (cached_head = head.load(std::memory_order_acquire)) > mask)
+            {
+                stalls++;
+                std::this_thread::yield();
+            }
+        }
+
+        records[position & mask] = record;
+        tail.store(position + 1, std::memory_order_release);
+    }
+
+    // Consumer side, the records up to the end of the ring or the newest one, whichever comes first
+    [[nodiscard]] std::span<const TraceRecord> readable() const noexcept;
+    void release(std::size_t count) noexcept;
+
+    [[nodiscard]] uint32_t stream() const noexcept { return stream_id; }
+    [[nodiscard]] uint64_t recorded() const noexcept { return tail.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t stallCount() const noexcept { return stalls; }
+};
+
+// Streams every attached ring to one file from a background thread.
+// File: magic, version and record size, then chunks of (stream, count, count records)
+class TraceRecorder
+{
+private:
+    std::ofstream file;
+    std::size_t capacity;
+    std::mutex buffers_mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::atomic<bool> running {false};
+    std::thread writer;
+    uint64_t written {};
+
+    // Writes whatever every ring holds, returns false when there was nothing
+    bool drain() noexcept;
+    void writeLoop() noexcept;
+
+public:
+    explicit TraceRecorder(const std::string& path, std::size_t capacity = trace::DEFAULT_CAPACITY) noexcept;
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    [[nodiscard]] bool isOpen() const noexcept { return file.is_open(); }
+
+    // A new ring for one producer, each thread running a CPU needs its own
+    [[nodiscard]] TraceBuffer& addStream() noexcept;
+
+    void start() noexcept;
+    // Joins the writer after it has written everything recorded so far
+    void stop() noexcept;
+
+    // Totals, read them after stop()
+    [[nodiscard]] uint64_t recordsWritten() const noexcept { return written; }
+    [[nodiscard]] uint64_t stallCount() noexcept;
+};
+
+// Reads a trace file record by record
+class TraceReader
+{
+private:
+    std::ifstream file;
+    bool valid {false};
+    uint32_t chunk_stream {};
+    uint32_t chunk_remaining {};
+
+public:
+    explicit TraceReader(const std::string& path) noexcept;
+
+    [[nodiscard]] bool isValid() const noexcept { return valid; }
+    bool next(uint32_t& stream, TraceRecord& record) noexcept;
+};
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "opcode.hpp"
+#include "trace.hpp"
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: chip8-trace <trace file> [--pc <first>-<last>] [--opcode <name>]...\n"
+                  << "                   [--stream N] [--count]\n"
+                  << "       Addresses are hexadecimal, opcode names are the handler names, e.g. drawOnDisplay\n";
+    }
+
+    bool parseRange(const std::string& text, int& first, int& last)
+    {
+        const std::size_t dash {text.find('-')};
+        if (dash == std::string::npos)
+            return false;
+
+        first = std::stoi(text.substr(0, dash), nullptr, 16);
+        last = std::stoi(text.substr(dash + 1), nullptr, 16);
+        return first <= last;
+    }
+
+    bool parseOpcode(const std::string& name, Opcode& op)
+    {
+        for (std::size_t i{0}; i < opcode::COUNT; ++i)
+        {
+            if (opcode::NAMES[i] == name)
+            {
+                op = static_cast<Opcode>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void printRecord(uint32_t stream, const TraceRecord& record)
+    {
+        std::cout << std::hex << std::uppercase << std::setfill('0')
+                  << stream << "  "
+                  << std::setw(4) << record.pc << "  "
+                  << std::setw(4) << record.word << "  "
+                  << std::left << std::setw(24) << std::setfill(' ') << opcode::name(opcode::TABLE[record.word]) << std::right << std::setfill('0')
+                  << "I=" << std::setw(4) << record.index;
+
+        if (record.reg != trace::NO_REGISTER)
+        {
+            std::cout << "  V" << (record.reg & 0xF) << '=' << std::setw(2) << static_cast<int>(record.value);
+            if (record.reg & trace::FLAG_CHANGED)
+                std::cout << "  VF changed";
+        }
+
+        std::cout << std::dec << std::nouppercase << '\n';
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string trace_path {};
+    int first_pc {0};
+    int last_pc {0xFFFF};
+    std::vector<Opcode> opcodes {};
+    long long stream {-1};
+    bool count_only {false};
+
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string arg {argv[i]};
+        const bool has_value {i + 1 < argc};
+        Opcode op {};
+
+        if (arg == "--pc" && has_value && parseRange(argv[i + 1], first_pc, last_pc))
+            ++i;
+        else if (arg == "--opcode" && has_value && parseOpcode(argv[i + 1], op))
+        {
+            opcodes.push_back(op);
+            ++i;
+        }
+        else if (arg == "--stream" && has_value)
+            stream = std::stoll(argv[++i]);
+        else if (arg == "--count")
+            count_only = true;
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage();
+            return -1;
+        }
+        else
+            trace_path = arg;
+    }
+
+    if (trace_path.empty())
+    {
+        printUsage();
+        return -1;
+    }
+
+    TraceReader reader {trace_path};
+    if (!reader.isValid())
+    {
+        std::cout << "Could not read trace " << trace_path << '\n';
+        return -1;
+    }
+
+    uint64_t total {0};
+    uint64_t matched {0};
+    uint32_t record_stream {};
+    TraceRecord record {};
+
+    while (reader.next(record_stream, record))
+    {
+        total++;
+
+        if (stream >= 0 && record_stream != stream)
+            continue;
+        if (record.pc < first_pc || record.pc > last_pc)
+            continue;
+        if (!opcodes.empty() && std::find(opcodes.begin(), opcodes.end(), opcode::TABLE[record.word]) == opcodes.end())
+            continue;
+
+        matched++;
+        if (!count_only)
+            printRecord(record_stream, record);
+    }
+
+    std::cout << matched << " of " << total << " records\n";
+    return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one producer thread to one consumer thread without either ever waiting.
+// The producer fills the back slot and swaps it with the middle one, the consumer swaps the
+// middle slot with its front one only when something new was published, so the consumer
+// always sees the latest complete value and intermediate ones are dropped
+template<typename T>
+class TripleBuffer
+{
+private:
+    static constexpr uint8_t INDEX_MASK {0x3};
+    static constexpr uint8_t FRESH {0x4};
+
+    std::array<T, 3> slots {};
+    alignas(64) std::atomic<uint8_t> middle {1};
+    alignas(64) uint8_t back {0};
+    alignas(64) uint8_t front {2};
+
+public:
+    // Producer side, the slot to fill before publish()
+    [[nodiscard]] T& writeBuffer() noexcept
+    {
+        return slots[back];
+    }
+
+    // Returns true when the previously published value was never consumed
+    bool publish() noexcept
+    {
+        const uint8_t previous {middle.exchange(back | FRESH, std::memory_order_acq_rel)};
+        back = previous & INDEX_MASK;
+        return previous & FRESH;
+    }
+
+    // Consumer side, returns false and keeps the current front slot when nothing new was published
+    bool consume() noexcept
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+
+        const uint8_t previous {middle.exchange(front, std::memory_order_acq_rel)};
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    [[nodiscard]] const T& readBuffer() const noexcept
+    {
+        return slots[front];
+    }
+};
@@ -3,25 +3,47 @@
 #include <array>
 #include <string>
 #include <fstream>
+#include <chrono>
 
 namespace display
 {
+    // Window pixels per high resolution pixel, a low resolution pixel is twice as large
     constexpr int PIXEL_SIZE {5};
+
+    // CHIP-8 low resolution
     constexpr int WIDTH {64};
     constexpr int HEIGHT {32};
+
+    // SUPER-CHIP and XO-CHIP high resolution
+    constexpr int HIRES_WIDTH {128};
+    constexpr int HIRES_HEIGHT {64};
+
+    // XO-CHIP bitplanes, a pixel's colour is the bit from each plane
+    constexpr int PLANES {2};
+
+    // Palette as 0xRRGGBBAA
+    constexpr uint32_t ON_COLOR {0xFFFFFFFF};
+    constexpr uint32_t OFF_COLOR {0x000000FF};
+
+    // Indexed by (plane 2 bit << 1) | plane 1 bit
+    constexpr std::array<uint32_t, 4> PALETTE {OFF_COLOR, ON_COLOR, 0xAA4400FF, 0x666666FF};
 }
 
 namespace window
 {
-    constexpr int WIDTH {display::WIDTH * display::PIXEL_SIZE};
-    constexpr int HEIGHT {display::HEIGHT * display::PIXEL_SIZE};
+    constexpr int WIDTH {display::HIRES_WIDTH * display::PIXEL_SIZE};
+    constexpr int HEIGHT {display::HIRES_HEIGHT * display::PIXEL_SIZE};
     inline const std::string TITLE {"Chip-8 Emulator"};
 }
 
 namespace memory
 {
+    // CHIP-8 and SUPER-CHIP address space, addresses wrap at 4 KB
     constexpr int SIZE {4096};
+    // XO-CHIP address space, reachable through F000 NNNN
+    constexpr int XO_CHIP_SIZE {65536};
     constexpr int PROGRAM_OFFSET {0x200};
+    constexpr int PAGE_SIZE {256};
 }
 
 namespace font_buffer
@@ -30,7 +52,18 @@ namespace font_buffer
     constexpr int OFFSET {0x50};
 }
 
+namespace idle
+{
+    // Backward jumps further than this are taken as real work rather than a polling loop
+    constexpr int MAX_LOOP_BYTES {32};
+}
+
 namespace timer
 {
-    constexpr int TIMER_FREQ_IN_MILLISECONDS { 1000 / 60 + 1 };
+    // Instructions run per 60 Hz timer tick, about 720 Hz
+    constexpr int CYCLES_PER_FRAME {12};
+    constexpr std::chrono::nanoseconds FRAME_DURATION {1'000'000'000 / 60};
+
+    // Emulated frames run per host frame while fast-forwarding
+    constexpr int FAST_FORWARD_FACTOR {8};
 }
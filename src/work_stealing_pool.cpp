@@ -0,0 +1,92 @@
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+
+bool WorkStealingPool::popLocal(std::size_t worker, std::function<void()>& task) noexcept
+{
+    Queue& queue {*queues[worker]};
+    std::lock_guard<std::mutex> guard {queue.mutex};
+
+    if (queue.tasks.empty())
+        return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(std::size_t worker, std::function<void()>& task) noexcept
+{
+    for (std::size_t offset{1}; offset < queues.size(); ++offset)
+    {
+        Queue& victim {*queues[(worker + offset) % queues.size()]};
+        std::lock_guard<std::mutex> guard {victim.mutex};
+
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::work(std::size_t worker) noexcept
+{
+    std::function<void()> task {};
+
+    while (true)
+    {
+        // Read before looking for work, so a submit or completion in between makes wait() return at once
+        const std::size_t left {remaining.load()};
+
+        if (popLocal(worker, task) || steal(worker, task))
+        {
+            task();
+            if (--remaining == 0)
+                remaining.notify_all();
+            continue;
+        }
+
+        if (left == 0)
+            return;
+
+        // Every queue is empty, sleep until the last task finishes or more are submitted
+        remaining.wait(left);
+    }
+}
+
+WorkStealingPool::WorkStealingPool(unsigned worker_count) noexcept
+{
+    worker_count = std::max(worker_count, 1u);
+
+    for (unsigned i{0}; i < worker_count; ++i)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) noexcept
+{
+    Queue& queue {*queues[next_queue]};
+    next_queue = (next_queue + 1) % queues.size();
+
+    std::lock_guard<std::mutex> guard {queue.mutex};
+    queue.tasks.push_back(std::move(task));
+    remaining++;
+    remaining.notify_all();
+}
+
+void WorkStealingPool::run() noexcept
+{
+    std::vector<std::jthread> workers {};
+
+    for (std::size_t worker{1}; worker < queues.size(); ++worker)
+    {
+        workers.emplace_back(&WorkStealingPool::work, this, worker);
+    }
+
+    work(0);
+}
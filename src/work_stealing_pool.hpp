@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a batch of independent tasks, idle workers steal from the front of other workers' queues
+// and sleep on the remaining count once there is nothing left to steal
+class WorkStealingPool
+{
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<std::size_t> remaining {};
+    std::atomic<std::size_t> steals {};
+    std::size_t next_queue {};
+
+    bool popLocal(std::size_t worker, std::function<void()>& task) noexcept;
+    bool steal(std::size_t worker, std::function<void()>& task) noexcept;
+    void work(std::size_t worker) noexcept;
+
+public:
+    explicit WorkStealingPool(unsigned worker_count) noexcept;
+
+    void submit(std::function<void()> task) noexcept;
+
+    // Blocks until every submitted task has finished
+    void run() noexcept;
+
+    [[nodiscard]] std::size_t workerCount() const noexcept { return queues.size(); }
+    [[nodiscard]] std::size_t stealCount() const noexcept { return steals; }
+};
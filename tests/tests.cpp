@@ -3,6 +3,30 @@
 #include "display.hpp"
 #include "memory.hpp"
 #include "cpu.hpp"
+#include "block_cache.hpp"
+#include "work_stealing_pool.hpp"
+#include "recording.hpp"
+#include "machine_state.hpp"
+#include "rewind.hpp"
+#include "instrumentation.hpp"
+#include "call_graph.hpp"
+#include "triple_buffer.hpp"
+#include "trace.hpp"
+#include "recompiler.hpp"
+#include "capture.hpp"
+#include "golden.hpp"
+#include "protocol.hpp"
+#ifdef __linux__
+#include "server.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <thread>
 
 class MockDisplay : public Display
 {
@@ -48,6 +72,204 @@ TEST(Display, Clear)
     EXPECT_EQ(display.get(25, 15), Pixel::off);
 }
 
+TEST(Display, DrawSpriteRow)
+{
+    Display display;
+
+    EXPECT_FALSE(display.drawSpriteRow(4, 3, 0b10100000));
+    EXPECT_EQ(display.get(4, 3), Pixel::on);
+    EXPECT_EQ(display.get(5, 3), Pixel::off);
+    EXPECT_EQ(display.get(6, 3), Pixel::on);
+    EXPECT_EQ(display.rows()[0][3][0], display_word_t{0b101} << (display::WORD_BITS - 7));
+
+    // Overlapping pixel is turned off and reported
+    EXPECT_TRUE(display.drawSpriteRow(6, 3, 0b10000000));
+    EXPECT_EQ(display.get(6, 3), Pixel::off);
+
+    // Clipped at the right edge
+    EXPECT_FALSE(display.drawSpriteRow(display::WIDTH - 2, 0, 0xFF));
+    EXPECT_EQ(display.get(display::WIDTH - 1, 0), Pixel::on);
+    EXPECT_EQ(display.get(0, 0), Pixel::off);
+    EXPECT_EQ(display.get(0, 1), Pixel::off);
+}
+
+TEST(Display, DirtyRows)
+{
+    Display display;
+    EXPECT_EQ(display.dirtyRows(), 0);
+    EXPECT_EQ(display.generation(), 0);
+
+    display.set(2, 5, Pixel::on);
+    display.drawSpriteRow(0, 7, 0x80);
+    EXPECT_EQ(display.dirtyRows(), (dirty_rows_t{1} << 5) | (dirty_rows_t{1} << 7));
+    EXPECT_EQ(display.generation(), 2);
+
+    EXPECT_EQ(display.takeDirtyRows(), (dirty_rows_t{1} << 5) | (dirty_rows_t{1} << 7));
+    EXPECT_EQ(display.dirtyRows(), 0);
+
+    // Writes that leave the row as it was change nothing
+    display.set(2, 5, Pixel::on);
+    display.set(3, 6, Pixel::off);
+    display.drawSpriteRow(0, 8, 0x00);
+    EXPECT_EQ(display.dirtyRows(), 0);
+    EXPECT_EQ(display.generation(), 2);
+
+    display.clear();
+    EXPECT_EQ(display.dirtyRows(), (dirty_rows_t{1} << 5) | (dirty_rows_t{1} << 7));
+    EXPECT_EQ(display.generation(), 4);
+}
+
+TEST(Display, ChangeTime)
+{
+    Display display;
+    EXPECT_FALSE(display.takeChangeTime());
+
+    // The first change is stamped, later ones keep its time until it is taken
+    const auto before {std::chrono::steady_clock::now()};
+    display.set(2, 5, Pixel::on);
+    const auto after_first {std::chrono::steady_clock::now()};
+    display.set(3, 5, Pixel::on);
+
+    const auto changed_at {display.takeChangeTime()};
+    ASSERT_TRUE(changed_at);
+    EXPECT_GE(*changed_at, before);
+    EXPECT_LE(*changed_at, after_first);
+    EXPECT_FALSE(display.takeChangeTime());
+
+    // A write that leaves the display as it was is not a change
+    display.set(2, 5, Pixel::on);
+    EXPECT_FALSE(display.takeChangeTime());
+
+    display.scrollDown(1);
+    EXPECT_TRUE(display.takeChangeTime());
+}
+
+TEST(Display, HighResolution)
+{
+    Display display;
+    display.setHires(true);
+    EXPECT_EQ(display.width(), display::HIRES_WIDTH);
+    EXPECT_EQ(display.dirtyRows(), ~dirty_rows_t{0});
+
+    // A sprite straddling the two words of a row
+    EXPECT_FALSE(display.drawSpriteRow(0, 60, 40, 0xFF00));
+    EXPECT_EQ(display.get(59, 40), Pixel::off);
+    EXPECT_EQ(display.get(60, 40), Pixel::on);
+    EXPECT_EQ(display.get(67, 40), Pixel::on);
+    EXPECT_EQ(display.get(68, 40), Pixel::off);
+
+    // Clipped at the right edge instead of wrapping
+    display.drawSpriteRow(0, display::HIRES_WIDTH - 4, 63, 0xFFFF);
+    EXPECT_EQ(display.get(display::HIRES_WIDTH - 1, 63), Pixel::on);
+    EXPECT_EQ(display.get(0, 63), Pixel::off);
+
+    display.setHires(false);
+    EXPECT_EQ(display.get(60, 40), Pixel::off);
+    EXPECT_EQ(display.rows(), display_t{});
+}
+
+TEST(Display, Scroll)
+{
+    Display display;
+    display.setHires(true);
+    display.set(62, 10, Pixel::on);
+
+    display.scrollDown(3);
+    EXPECT_EQ(display.get(62, 13), Pixel::on);
+    EXPECT_EQ(display.get(62, 10), Pixel::off);
+
+    display.scrollRight(4);
+    EXPECT_EQ(display.get(66, 13), Pixel::on);
+
+    display.scrollLeft(4);
+    display.scrollUp(3);
+    EXPECT_EQ(display.get(62, 10), Pixel::on);
+
+    // Scrolled off the screen
+    display.scrollUp(11);
+    EXPECT_EQ(display.rows(), display_t{});
+
+    // Low resolution scrolls never leak pixels past the visible area
+    display.setHires(false);
+    display.set(63, 0, Pixel::on);
+    display.scrollRight(4);
+    EXPECT_EQ(display.rows(), display_t{});
+}
+
+TEST(Display, Planes)
+{
+    Display display;
+    display.selectPlanes(2);
+    display.drawSpriteRow(1, 0, 0, 0x8000);
+    EXPECT_EQ(display.color(0, 0), 2);
+
+    display.selectPlanes(3);
+    display.set(1, 0, Pixel::on);
+    EXPECT_EQ(display.color(1, 0), 3);
+
+    // Clearing leaves unselected planes alone
+    display.selectPlanes(1);
+    display.clear();
+    EXPECT_EQ(display.color(0, 0), 2);
+    EXPECT_EQ(display.color(1, 0), 2);
+    EXPECT_EQ(display.get(1, 0), Pixel::off);
+}
+
+TEST(TripleBuffer, LatestValueWins)
+{
+    TripleBuffer<int> buffer;
+    EXPECT_FALSE(buffer.consume());
+
+    buffer.writeBuffer() = 1;
+    EXPECT_FALSE(buffer.publish());
+    buffer.writeBuffer() = 2;
+    EXPECT_TRUE(buffer.publish()); // 1 was never consumed
+
+    EXPECT_TRUE(buffer.consume());
+    EXPECT_EQ(buffer.readBuffer(), 2);
+    EXPECT_FALSE(buffer.consume());
+    EXPECT_EQ(buffer.readBuffer(), 2);
+
+    buffer.writeBuffer() = 3;
+    EXPECT_FALSE(buffer.publish());
+    EXPECT_TRUE(buffer.consume());
+    EXPECT_EQ(buffer.readBuffer(), 3);
+}
+
+TEST(TripleBuffer, ConsumerNeverSeesTornOrOlderValues)
+{
+    struct Frame
+    {
+        std::array<uint64_t, 64> words {};
+    };
+
+    TripleBuffer<Frame> buffer;
+    constexpr uint64_t LAST {20000};
+
+    std::thread producer {[&buffer]
+    {
+        for (uint64_t value{1}; value <= LAST; ++value)
+        {
+            buffer.writeBuffer().words.fill(value);
+            buffer.publish();
+        }
+    }};
+
+    uint64_t seen {0};
+    while (seen != LAST)
+    {
+        if (!buffer.consume())
+            continue;
+
+        const Frame& frame {buffer.readBuffer()};
+        ASSERT_GT(frame.words[0], seen);
+        ASSERT_EQ(frame.words[63], frame.words[0]);
+        seen = frame.words[0];
+    }
+
+    producer.join();
+}
+
 TEST(Memory, LoadFonts)
 {
     Memory memory;
@@ -59,6 +281,79 @@ TEST(Memory, LoadFonts)
     EXPECT_EQ(memory.getByte(font_buffer::OFFSET + 4), 0xF0);
 }
 
+TEST(Memory, LoadProgramReportsUnreadableFiles)
+{
+    Memory memory;
+
+    EXPECT_FALSE(memory.loadProgram("no_such_rom.ch8"));
+    EXPECT_FALSE(memory.loadProgram("."));
+    EXPECT_EQ(memory.getByte(memory::PROGRAM_OFFSET), 0x00);
+}
+
+TEST(Memory, PredecodeCache)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{0x61, 0x05, 0x12, 0x00});
+
+    EXPECT_EQ(memory.fetch(0x200).op, Opcode::setRegister);
+    EXPECT_EQ(memory.fetch(0x200).inst.asWord, 0x6105);
+    EXPECT_EQ(memory.predecodeMisses(), 1);
+    EXPECT_EQ(memory.predecodeHits(), 1);
+
+    // Writing the second byte of an instruction invalidates it
+    memory.setByte(0x201, 0x07);
+    EXPECT_EQ(memory.fetch(0x200).inst.asWord, 0x6107);
+    EXPECT_EQ(memory.predecodeMisses(), 2);
+
+    // Writing the first byte of the next instruction invalidates both overlapping entries
+    static_cast<void>(memory.fetch(0x201));
+    memory.setByte(0x202, 0xA3);
+    EXPECT_EQ(memory.fetch(0x201).inst.asWord, 0x07A3);
+    EXPECT_EQ(memory.fetch(0x202).op, Opcode::setIndexRegister);
+    EXPECT_EQ(memory.predecodeMisses(), 5);
+}
+
+TEST(Memory, SizedPerProfile)
+{
+    Memory memory {memorySize(Profile::superChip)};
+    EXPECT_EQ(memory.size(), 4096);
+
+    // Past 4 KB wraps back to the start, as on the original interpreters
+    memory.setByte(0x1234, 0xAB);
+    EXPECT_EQ(memory.getByte(0x234), 0xAB);
+    EXPECT_EQ(memory.fetch(0x1234).inst.asWord, memory.fetch(0x234).inst.asWord);
+
+    Memory xo_memory {memorySize(Profile::xoChip)};
+    EXPECT_EQ(xo_memory.size(), 65536);
+    xo_memory.setByte(0x1234, 0xAB);
+    EXPECT_EQ(xo_memory.getByte(0x1234), 0xAB);
+    EXPECT_EQ(xo_memory.getByte(0x234), 0x00);
+
+    // A store running past 0xFFF wraps to 0x000 on a 4 KB profile
+    Memory cosmac_memory {memorySize(Profile::cosmac)};
+    cosmac_memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x5A, // V0 = 0x5A
+        0x61, 0x5B, // V1 = 0x5B
+        0xAF, 0xFF, // I = 0xFFF
+        0xF1, 0x55  // store V0..V1
+    });
+    CosmacCPU cosmac {&cosmac_memory};
+    cosmac.execute(4);
+    EXPECT_EQ(cosmac_memory.getByte(0xFFF), 0x5A);
+    EXPECT_EQ(cosmac_memory.getByte(0x000), 0x5B);
+
+    // A long index load reaches past 4 KB on XO-CHIP
+    xo_memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x5A,             // V0 = 0x5A
+        0xF0, 0x00, 0x12, 0x34, // I = 0x1234
+        0xF0, 0x55              // store V0
+    });
+    XoChipCPU xo {&xo_memory};
+    xo.execute(3);
+    EXPECT_EQ(xo_memory.getByte(0x1234), 0x5A);
+    EXPECT_EQ(xo_memory.getByte(0x234), 0x00);
+}
+
 TEST(CPU, Instruction)
 {
     uint8_t first_byte {0xAB};
@@ -72,10 +367,73 @@ TEST(CPU, Instruction)
     EXPECT_EQ(inst.asWord, 0xABCD);
 }
 
-TEST(CPU, setProgramCounter)
+TEST(CPU, OpcodeTable)
+{
+    EXPECT_EQ(opcode::TABLE[0x00E0], Opcode::clearScreen);
+    EXPECT_EQ(opcode::TABLE[0x00EE], Opcode::returnFromSubroutine);
+    EXPECT_EQ(opcode::TABLE[0x1ABC], Opcode::setProgramCounter);
+    EXPECT_EQ(opcode::TABLE[0x812E], Opcode::shiftLeft);
+    EXPECT_EQ(opcode::TABLE[0x8127], Opcode::unknown);
+    EXPECT_EQ(opcode::TABLE[0xF318], Opcode::setSoundTimer);
+    EXPECT_EQ(opcode::TABLE[0xF319], Opcode::unknown);
+    EXPECT_EQ(opcode::TABLE[0x00C4], Opcode::scrollDown);
+    EXPECT_EQ(opcode::TABLE[0x00FF], Opcode::highResolution);
+    EXPECT_EQ(opcode::TABLE[0xF201], Opcode::selectPlanes);
+    EXPECT_EQ(opcode::TABLE[0xF000], Opcode::loadLongIndex);
+    EXPECT_EQ(opcode::TABLE[0xF100], Opcode::unknown);
+}
+
+// Every CPU test runs once per quirks profile
+template <typename T>
+class CPUTest : public testing::Test
+{
+};
+
+using CpuProfiles = testing::Types<CosmacCPU, Chip48CPU, SuperChipCPU, XoChipCPU>;
+TYPED_TEST_SUITE(CPUTest, CpuProfiles);
+
+TYPED_TEST(CPUTest, execute)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x61, 0x05, // V1 = 5
+        0x71, 0x03, // V1 += 3
+        0xA1, 0x23, // I = 0x123
+        0x12, 0x00  // jump to 0x200
+    });
+    TypeParam cpu {&memory};
+
+    cpu.execute(3);
+    EXPECT_EQ(cpu.gp_regs[0x1], 8);
+    EXPECT_EQ(cpu.index_reg, 0x123);
+    EXPECT_EQ(cpu.program_counter, 0x206);
+
+    cpu.execute(1);
+    EXPECT_EQ(cpu.program_counter, 0x200);
+}
+
+TYPED_TEST(CPUTest, seed)
+{
+    MockMemory memory;
+    TypeParam first {&memory};
+    TypeParam second {&memory};
+    first.seed(1234);
+    second.seed(1234);
+
+    for (int i{0}; i < 16; ++i)
+    {
+        first.inst = {0xC0, 0xFF};
+        first.decode();
+        second.inst = {0xC0, 0xFF};
+        second.decode();
+        EXPECT_EQ(first.gp_regs[0x0], second.gp_regs[0x0]);
+    }
+}
+
+TYPED_TEST(CPUTest, setProgramCounter)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.inst = {0x1B, 0xCD};
     cpu.decode();
@@ -86,10 +444,10 @@ TEST(CPU, setProgramCounter)
     EXPECT_EQ(cpu.program_counter, 0x200);
 }
 
-TEST(CPU, setRegister)
+TYPED_TEST(CPUTest, setRegister)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.inst = {0x61, 0x11};
     cpu.decode();
@@ -104,10 +462,10 @@ TEST(CPU, setRegister)
     EXPECT_EQ(cpu.gp_regs[0x5], 0x33);
 }
 
-TEST(CPU, addToRegister)
+TYPED_TEST(CPUTest, addToRegister)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.inst = {0x71, 0x11};
     cpu.decode();
@@ -118,20 +476,180 @@ TEST(CPU, addToRegister)
     EXPECT_EQ(cpu.gp_regs[0x1], 0x33);
 }
 
-TEST(CPU, setIndexRegister)
+TYPED_TEST(CPUTest, setIndexRegister)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.inst = {0xA1, 0x23};
     cpu.decode();
     EXPECT_EQ(cpu.index_reg, 0x123);
 }
 
-TEST(CPU, assignment)
+TYPED_TEST(CPUTest, drawOnDisplay)
+{
+    Memory memory;
+    TypeParam cpu {&memory};
+
+    cpu.gp_regs[0x0] = 62;
+    cpu.gp_regs[0x1] = 30;
+    cpu.index_reg = font_buffer::OFFSET; // '0' glyph, F0 90 90 90 F0
+    cpu.inst = {0xD0, 0x15};
+    cpu.decode();
+    EXPECT_EQ(cpu.display.get(62, 30), Pixel::on);
+    EXPECT_EQ(cpu.display.get(63, 30), Pixel::on);
+    EXPECT_EQ(cpu.display.get(62, 31), Pixel::on);
+    EXPECT_EQ(cpu.display.get(63, 31), Pixel::off);
+    EXPECT_EQ(cpu.display.get(0, 30), Pixel::off);
+    EXPECT_EQ(cpu.display.get(62, 0), Pixel::off);
+    EXPECT_EQ(cpu.gp_regs[0xF], 0);
+
+    cpu.decode();
+    EXPECT_EQ(cpu.display.get(62, 30), Pixel::off);
+    EXPECT_EQ(cpu.gp_regs[0xF], 1);
+}
+
+TYPED_TEST(CPUTest, drawWideSprite)
+{
+    Memory memory;
+    TypeParam cpu {&memory};
+    for (int i{0}; i < 32; ++i)
+    {
+        memory.setByte(0x300 + i, 0xFF);
+    }
+
+    cpu.inst = {0x00, 0xFF};
+    cpu.decode();
+    EXPECT_EQ(cpu.display.isHires(), TypeParam::quirks_t::super_chip_instructions);
+
+    cpu.gp_regs[0x0] = 120;
+    cpu.gp_regs[0x1] = 60;
+    cpu.index_reg = 0x300;
+    cpu.inst = {0xD0, 0x10};
+    cpu.decode();
+
+    if constexpr (TypeParam::quirks_t::super_chip_instructions)
+    {
+        EXPECT_EQ(cpu.display.get(120, 60), Pixel::on);
+        EXPECT_EQ(cpu.display.get(127, 63), Pixel::on);
+        EXPECT_EQ(cpu.display.get(0, 60), Pixel::off);
+        EXPECT_EQ(cpu.display.get(120, 0), Pixel::off);
+
+        cpu.inst = {0x00, 0xFE};
+        cpu.decode();
+        EXPECT_FALSE(cpu.display.isHires());
+        EXPECT_EQ(cpu.display.get(120, 60), Pixel::off);
+    }
+    else
+    {
+        // DXY0 draws no rows before SUPER-CHIP
+        for (int y{0}; y < display::HEIGHT; ++y)
+        {
+            for (int x{0}; x < display::WIDTH; ++x)
+            {
+                ASSERT_EQ(cpu.display.get(x, y), Pixel::off);
+            }
+        }
+        EXPECT_EQ(cpu.gp_regs[0xF], 0);
+    }
+}
+
+TYPED_TEST(CPUTest, scroll)
+{
+    Memory memory;
+    TypeParam cpu {&memory};
+    cpu.index_reg = 0x300;
+    memory.setByte(0x300, 0x80);
+    cpu.inst = {0xD0, 0x01};
+    cpu.decode();
+
+    // 00C1 then 00FB, one row down and four pixels right
+    cpu.inst = {0x00, 0xC1};
+    cpu.decode();
+    cpu.inst = {0x00, 0xFB};
+    cpu.decode();
+
+    if constexpr (TypeParam::quirks_t::super_chip_instructions)
+    {
+        EXPECT_EQ(cpu.display.get(0, 0), Pixel::off);
+        EXPECT_EQ(cpu.display.get(4, 1), Pixel::on);
+    }
+    else
+        EXPECT_EQ(cpu.display.get(0, 0), Pixel::on);
+
+    // 00D1 only scrolls back up under XO-CHIP
+    cpu.inst = {0x00, 0xD1};
+    cpu.decode();
+    if constexpr (TypeParam::quirks_t::xo_chip_instructions)
+        EXPECT_EQ(cpu.display.get(4, 0), Pixel::on);
+    else if constexpr (TypeParam::quirks_t::super_chip_instructions)
+        EXPECT_EQ(cpu.display.get(4, 1), Pixel::on);
+}
+
+TYPED_TEST(CPUTest, drawBothPlanes)
+{
+    Memory memory;
+    TypeParam cpu {&memory};
+    memory.setByte(0x300, 0x80);
+    memory.setByte(0x301, 0x40);
+
+    // The second plane draws the sprite that follows the first, FN01 is unknown before XO-CHIP
+    cpu.inst = {0xF3, 0x01};
+    cpu.decode();
+    cpu.index_reg = 0x300;
+    cpu.inst = {0xD0, 0x01};
+    cpu.decode();
+
+    if constexpr (TypeParam::quirks_t::xo_chip_instructions)
+    {
+        EXPECT_EQ(cpu.display.color(0, 0), 1);
+        EXPECT_EQ(cpu.display.color(1, 0), 2);
+    }
+    else
+    {
+        EXPECT_EQ(cpu.display.color(0, 0), 1);
+        EXPECT_EQ(cpu.display.color(1, 0), 0);
+    }
+}
+
+TYPED_TEST(CPUTest, loadLongIndex)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0xF0, 0x00, 0x62, 0x07, // I = 0x6207, or an unknown word and V2 = 7
+        0x30, 0x00,             // skip if V0 == 0
+        0xF0, 0x00, 0x61, 0x01, // skipped whole, or only F000 is and V1 = 1
+        0x60, 0x01              // V0 = 1
+    });
+    TypeParam cpu {&memory};
+
+    if constexpr (TypeParam::quirks_t::xo_chip_instructions)
+    {
+        cpu.execute(1);
+        EXPECT_EQ(cpu.index_reg, 0x6207);
+        EXPECT_EQ(cpu.program_counter, 0x204);
+
+        cpu.execute(2);
+        EXPECT_EQ(cpu.gp_regs[0x1], 0);
+        EXPECT_EQ(cpu.gp_regs[0x0], 1);
+    }
+    else
+    {
+        cpu.execute(2);
+        EXPECT_EQ(cpu.index_reg, 0);
+        EXPECT_EQ(cpu.gp_regs[0x2], 7);
+        EXPECT_EQ(cpu.program_counter, 0x204);
+
+        cpu.execute(3);
+        EXPECT_EQ(cpu.gp_regs[0x1], 1);
+        EXPECT_EQ(cpu.gp_regs[0x0], 1);
+    }
+}
+
+TYPED_TEST(CPUTest, assignment)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.gp_regs[0x0] = 0;
     cpu.gp_regs[0x1] = 7;
@@ -141,49 +659,55 @@ TEST(CPU, assignment)
     EXPECT_EQ(cpu.gp_regs[0x0], 7);
 }
 
-TEST(CPU, OR)
+TYPED_TEST(CPUTest, OR)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.gp_regs[0x0] = 5;
     cpu.gp_regs[0x1] = 7;
+    cpu.gp_regs[0xF] = 9;
 
     cpu.inst = {0x80, 0x11};
     cpu.decode();
     EXPECT_EQ(cpu.gp_regs[0x0], 5 | 7);
+    EXPECT_EQ(cpu.gp_regs[0xF], TypeParam::quirks_t::logic_resets_vf ? 0 : 9);
 }
 
-TEST(CPU, AND)
+TYPED_TEST(CPUTest, AND)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.gp_regs[0x0] = 5;
     cpu.gp_regs[0x1] = 7;
+    cpu.gp_regs[0xF] = 9;
 
     cpu.inst = {0x80, 0x12};
     cpu.decode();
     EXPECT_EQ(cpu.gp_regs[0x0], 5 & 7);
+    EXPECT_EQ(cpu.gp_regs[0xF], TypeParam::quirks_t::logic_resets_vf ? 0 : 9);
 }
 
-TEST(CPU, XOR)
+TYPED_TEST(CPUTest, XOR)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.gp_regs[0x0] = 5;
     cpu.gp_regs[0x1] = 7;
+    cpu.gp_regs[0xF] = 9;
 
     cpu.inst = {0x80, 0x13};
     cpu.decode();
     EXPECT_EQ(cpu.gp_regs[0x0], 5 ^ 7);
+    EXPECT_EQ(cpu.gp_regs[0xF], TypeParam::quirks_t::logic_resets_vf ? 0 : 9);
 }
 
-TEST(CPU, addWithCarry)
+TYPED_TEST(CPUTest, addWithCarry)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.gp_regs[0x0] = 5;
     cpu.gp_regs[0x1] = 7;
@@ -202,10 +726,10 @@ TEST(CPU, addWithCarry)
     EXPECT_EQ(cpu.gp_regs[0xF], 1);
 }
 
-TEST(CPU, subtract)
+TYPED_TEST(CPUTest, subtract)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.gp_regs[0x0] = 12;
     cpu.gp_regs[0x1] = 7;
@@ -224,10 +748,10 @@ TEST(CPU, subtract)
     EXPECT_EQ(cpu.gp_regs[0xF], 0);
 }
 
-TEST(CPU, callSubroutine)
+TYPED_TEST(CPUTest, callSubroutine)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.program_counter = 0x111;
     cpu.inst = {0x21, 0x23};
@@ -237,10 +761,10 @@ TEST(CPU, callSubroutine)
     EXPECT_EQ(cpu.program_counter, 0x123);
 }
 
-TEST(CPU, returnFromSubroutine)
+TYPED_TEST(CPUTest, returnFromSubroutine)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
     cpu.program_counter = 0x111;
     cpu.inst = {0x21, 0x23};
@@ -252,17 +776,22 @@ TEST(CPU, returnFromSubroutine)
     EXPECT_EQ(cpu.cpu_stack.size(), 0);
 }
 
-TEST(CPU, shiftRight)
+TYPED_TEST(CPUTest, shiftRight)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
+
+    // COSMAC shifts VY into VX, later interpreters shift VX in place
+    const bool copies_vy {TypeParam::quirks_t::shift_copies_vy};
 
+    cpu.gp_regs[0] = 0x40;
     cpu.gp_regs[1] = 0x11;
     cpu.inst = {0x80, 0x16};
     cpu.decode();
-    EXPECT_EQ(cpu.gp_regs[0], 0x11 >> 1);
-    EXPECT_EQ(cpu.gp_regs[0xF], 1);
+    EXPECT_EQ(cpu.gp_regs[0], copies_vy ? 0x11 >> 1 : 0x40 >> 1);
+    EXPECT_EQ(cpu.gp_regs[0xF], copies_vy ? 1 : 0);
 
+    cpu.gp_regs[0] = 0x82;
     cpu.gp_regs[1] = 0x82;
     cpu.inst = {0x80, 0x16};
     cpu.decode();
@@ -270,17 +799,21 @@ TEST(CPU, shiftRight)
     EXPECT_EQ(cpu.gp_regs[0xF], 0);
 }
 
-TEST(CPU, shiftLeft)
+TYPED_TEST(CPUTest, shiftLeft)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
+
+    const bool copies_vy {TypeParam::quirks_t::shift_copies_vy};
 
+    cpu.gp_regs[0] = 0x81;
     cpu.gp_regs[1] = 0x12;
     cpu.inst = {0x80, 0x1E};
     cpu.decode();
-    EXPECT_EQ(cpu.gp_regs[0], static_cast<uint8_t>(0x12 << 1));
-    EXPECT_EQ(cpu.gp_regs[0xF], 0);
+    EXPECT_EQ(cpu.gp_regs[0], copies_vy ? 0x12 << 1 : static_cast<uint8_t>(0x81 << 1));
+    EXPECT_EQ(cpu.gp_regs[0xF], copies_vy ? 0 : 1);
 
+    cpu.gp_regs[0] = 0x82;
     cpu.gp_regs[1] = 0x82;
     cpu.inst = {0x80, 0x1E};
     cpu.decode();
@@ -288,13 +821,1463 @@ TEST(CPU, shiftLeft)
     EXPECT_EQ(cpu.gp_regs[0xF], 1);
 }
 
-TEST(CPU, jumpWithOffset)
+TYPED_TEST(CPUTest, jumpWithOffset)
 {
     MockMemory memory;
-    CPU cpu {&memory};
+    TypeParam cpu {&memory};
 
+    // BNNN adds V0 on the COSMAC, CHIP-48 reads it as BXNN and adds VX
     cpu.gp_regs[0] = 0x2;
+    cpu.gp_regs[1] = 0x4;
     cpu.inst = {0xB1, 0x23};
     cpu.decode();
-    EXPECT_EQ(cpu.program_counter, 0x125);
+    EXPECT_EQ(cpu.program_counter, TypeParam::quirks_t::jump_adds_vx ? 0x127 : 0x125);
+}
+
+TYPED_TEST(CPUTest, storeBCD)
+{
+    Memory memory;
+    TypeParam cpu {&memory};
+
+    cpu.gp_regs[0x3] = 254;
+    cpu.index_reg = 0x300;
+    cpu.inst = {0xF3, 0x33};
+    cpu.decode();
+    EXPECT_EQ(memory.getByte(0x300), 2);
+    EXPECT_EQ(memory.getByte(0x301), 5);
+    EXPECT_EQ(memory.getByte(0x302), 4);
+}
+
+TYPED_TEST(CPUTest, storeAndLoadRegisters)
+{
+    Memory memory;
+    TypeParam cpu {&memory};
+
+    constexpr int expected_index[] {0x303, 0x302, 0x300};
+    const int index {expected_index[static_cast<int>(TypeParam::quirks_t::index_increment)]};
+
+    cpu.gp_regs = {1, 2, 3};
+    cpu.index_reg = 0x300;
+    cpu.inst = {0xF2, 0x55};
+    cpu.decode();
+    EXPECT_EQ(memory.getByte(0x302), 3);
+    EXPECT_EQ(cpu.index_reg, index);
+
+    cpu.gp_regs = {};
+    cpu.index_reg = 0x300;
+    cpu.inst = {0xF2, 0x65};
+    cpu.decode();
+    EXPECT_EQ(cpu.gp_regs[0x0], 1);
+    EXPECT_EQ(cpu.gp_regs[0x2], 3);
+    EXPECT_EQ(cpu.index_reg, index);
+}
+
+TYPED_TEST(CPUTest, selfModifyingCode)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x12, // V0 = 0x12
+        0x61, 0x08, // V1 = 0x08
+        0xA2, 0x0C, // I = 0x20C
+        0x22, 0x0C, // call 0x20C
+        0xF1, 0x55, // store V0..V1 at 0x20C, rewriting the subroutine into 1208
+        0x22, 0x0C, // call 0x20C again
+        0x63, 0x07, // V3 = 7
+        0x00, 0xEE  // return
+    });
+    TypeParam cpu {&memory};
+
+    cpu.execute(6);
+    EXPECT_EQ(cpu.gp_regs[0x3], 7);
+    EXPECT_EQ(cpu.program_counter, 0x208);
+
+    cpu.execute(3);
+    EXPECT_EQ(cpu.program_counter, 0x208);
+}
+
+TYPED_TEST(CPUTest, skipIfEqual)
+{
+    MockMemory memory;
+    TypeParam cpu {&memory};
+
+    cpu.gp_regs[0x1] = 0x22;
+    cpu.inst = {0x31, 0x22};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x202);
+
+    cpu.inst = {0x41, 0x22};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x202);
+
+    cpu.inst = {0x41, 0x23};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x204);
+}
+
+TYPED_TEST(CPUTest, skipIfRegistersEqual)
+{
+    MockMemory memory;
+    TypeParam cpu {&memory};
+
+    cpu.gp_regs[0x1] = 0x22;
+    cpu.gp_regs[0x2] = 0x22;
+    cpu.inst = {0x51, 0x20};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x202);
+
+    cpu.inst = {0x91, 0x20};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x202);
+
+    cpu.gp_regs[0x2] = 0x23;
+    cpu.inst = {0x91, 0x20};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x204);
+}
+
+TEST(BlockCache, Translate)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x61, 0x05, // V1 = 5
+        0x71, 0x03, // V1 += 3
+        0x31, 0x08, // skip if V1 == 8, ends the block
+        0x12, 0x00  // jump to 0x200
+    });
+    BlockCache cache {&memory};
+
+    Block& block {cache.lookup(0x200)};
+    EXPECT_EQ(block.instructions.size(), 3);
+    EXPECT_EQ(block.end, 0x206);
+    EXPECT_TRUE(cache.isCurrent(block));
+    EXPECT_EQ(&cache.lookup(0x200), &block);
+    EXPECT_EQ(cache.translationCount(), 1);
+
+    memory.setByte(0x203, 0x04);
+    EXPECT_FALSE(cache.isCurrent(block));
+    EXPECT_EQ(cache.lookup(0x200).instructions[1].inst.asWord, 0x7104);
+    EXPECT_EQ(cache.translationCount(), 2);
+}
+
+TEST(BlockCache, StoreOutsideTheBlockKeepsItCurrent)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x01, // V0 = 1
+        0x12, 0x00  // jump to 0x200
+    });
+    BlockCache cache {&memory};
+
+    Block& block {cache.lookup(0x200)};
+    memory.setByte(0x300, 0xAB);
+    EXPECT_TRUE(cache.isCurrent(block));
+    EXPECT_EQ(&cache.lookup(0x200), &block);
+    EXPECT_EQ(cache.translationCount(), 1);
+}
+
+namespace
+{
+    // Loops, subroutines, skips, drawing and a store that rewrites code inside its own block
+    const std::vector<uint8_t> DIFFERENTIAL_PROGRAM {
+        0x60, 0x00, // 200: V0 = 0
+        0x61, 0x05, // 202: V1 = 5
+        0xA0, 0x50, // 204: I = 0x050
+        0xD0, 0x15, // 206: draw V0, V1, 5 rows
+        0x70, 0x08, // 208: V0 += 8
+        0x22, 0x24, // 20A: call 0x224
+        0x30, 0x40, // 20C: skip if V0 == 0x40
+        0x12, 0x06, // 20E: jump to 0x206
+        0x90, 0x10, // 210: skip if V0 != V1
+        0x00, 0x00, // 212:
+        0x60, 0x12, // 214: V0 = 0x12
+        0x61, 0x00, // 216: V1 = 0x00
+        0xA2, 0x1E, // 218: I = 0x21E
+        0xF1, 0x55, // 21A: store V0..V1, rewriting 0x21E into 1200
+        0x62, 0x07, // 21C: V2 = 7
+        0x72, 0x01, // 21E: V2 += 1
+        0x12, 0x20, // 220: jump to self
+        0x00, 0x00, // 222:
+        0x82, 0x04, // 224: V2 += V0
+        0x83, 0x26, // 226: V3 = V2 >> 1
+        0xF2, 0x33, // 228: BCD of V2 at I
+        0x00, 0xEE  // 22A: return
+    };
+
+    void expectSameState(const CPU& expected, const CPU& actual, int step)
+    {
+        ASSERT_EQ(expected.program_counter, actual.program_counter) << "step " << step;
+        ASSERT_EQ(expected.index_reg, actual.index_reg) << "step " << step;
+        ASSERT_EQ(expected.gp_regs, actual.gp_regs) << "step " << step;
+        ASSERT_EQ(expected.cpu_stack, actual.cpu_stack) << "step " << step;
+
+        for (int y{0}; y < display::HEIGHT; ++y)
+        {
+            for (int x{0}; x < display::WIDTH; ++x)
+            {
+                ASSERT_EQ(expected.display.get(x, y), actual.display.get(x, y)) << "step " << step;
+            }
+        }
+    }
+}
+
+TEST(BlockCache, MatchesInterpreterPerInstruction)
+{
+    Memory interpreter_memory;
+    Memory block_memory;
+    interpreter_memory.loadProgram(DIFFERENTIAL_PROGRAM);
+    block_memory.loadProgram(DIFFERENTIAL_PROGRAM);
+
+    CosmacCPU interpreter {&interpreter_memory};
+    CosmacCPU translated {&block_memory};
+    translated.backend = Backend::blockCache;
+
+    for (int step{0}; step < 2000; ++step)
+    {
+        interpreter.execute(1);
+        translated.execute(1);
+        expectSameState(interpreter, translated, step);
+    }
+}
+
+TEST(BlockCache, MatchesInterpreterAcrossChainedBlocks)
+{
+    Memory interpreter_memory;
+    Memory block_memory;
+    interpreter_memory.loadProgram(DIFFERENTIAL_PROGRAM);
+    block_memory.loadProgram(DIFFERENTIAL_PROGRAM);
+
+    CosmacCPU interpreter {&interpreter_memory};
+    CosmacCPU translated {&block_memory};
+    translated.backend = Backend::blockCache;
+
+    int step {0};
+    for (int batch{1}; step < 5000; batch = batch % 17 + 1)
+    {
+        for (int i{0}; i < batch; ++i)
+        {
+            interpreter.execute(1);
+        }
+
+        translated.execute(batch);
+        step += batch;
+        expectSameState(interpreter, translated, step);
+    }
+}
+
+TEST(BlockCache, ReturnToSeveralCallersStaysChained)
+{
+    const std::vector<uint8_t> program {
+        0x22, 0x0A, // 200: call 0x20A
+        0x70, 0x01, // 202: V0 += 1
+        0x22, 0x0A, // 204: call 0x20A
+        0x12, 0x00, // 206: jump to 0x200
+        0x00, 0x00, // 208:
+        0xA3, 0x00, // 20A: I = 0x300
+        0xF0, 0x33, // 20C: BCD of V0 at I
+        0x00, 0xEE  // 20E: return
+    };
+    Memory interpreter_memory;
+    Memory block_memory;
+    interpreter_memory.loadProgram(program);
+    block_memory.loadProgram(program);
+
+    CosmacCPU interpreter {&interpreter_memory};
+    CosmacCPU translated {&block_memory};
+    translated.backend = Backend::blockCache;
+
+    interpreter.execute(100);
+    translated.execute(100);
+    expectSameState(interpreter, translated, 100);
+
+    const uint64_t warm {translated.blockTranslations()};
+    interpreter.execute(10'000);
+    translated.execute(10'000);
+    expectSameState(interpreter, translated, 10'100);
+    EXPECT_EQ(translated.blockTranslations(), warm);
+}
+
+TEST(WorkStealingPool, RunsEveryTaskOnce)
+{
+    WorkStealingPool pool {4};
+    std::vector<std::atomic<int>> runs(1000);
+
+    for (auto& count : runs)
+    {
+        pool.submit([&count]
+        {
+            count++;
+        });
+    }
+
+    pool.run();
+
+    for (const auto& count : runs)
+    {
+        EXPECT_EQ(count, 1);
+    }
+}
+
+TEST(WorkStealingPool, IdleWorkersSleep)
+{
+    WorkStealingPool pool {4};
+    pool.submit([]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{200});
+    });
+
+    // Three workers find nothing to do for the whole 200 ms, sleeping they use next to no CPU time
+    const std::clock_t start {std::clock()};
+    pool.run();
+    const double cpu_ms {1000.0 * static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC};
+
+    EXPECT_LT(cpu_ms, 50.0);
+}
+
+TYPED_TEST(CPUTest, timers)
+{
+    MockMemory memory;
+    TypeParam cpu {&memory};
+
+    cpu.gp_regs[0x2] = 3;
+    cpu.inst = {0xF2, 0x15};
+    cpu.decode();
+    cpu.inst = {0xF2, 0x18};
+    cpu.decode();
+    EXPECT_EQ(cpu.delayTimer(), 3);
+    EXPECT_TRUE(cpu.isSoundActive());
+
+    cpu.tickTimers();
+    cpu.inst = {0xF4, 0x07};
+    cpu.decode();
+    EXPECT_EQ(cpu.gp_regs[0x4], 2);
+
+    cpu.tickTimers();
+    cpu.tickTimers();
+    cpu.tickTimers();
+    EXPECT_EQ(cpu.delayTimer(), 0);
+    EXPECT_FALSE(cpu.isSoundActive());
+}
+
+TYPED_TEST(CPUTest, runFrame)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x02, // V0 = 2
+        0xF0, 0x15, // delay timer = V0
+        0xF1, 0x07, // V1 = delay timer
+        0x31, 0x00, // skip if V1 == 0
+        0x12, 0x04, // jump to 0x204
+        0x12, 0x0A  // jump to self
+    });
+    TypeParam cpu {&memory};
+
+    cpu.runFrame(6);
+    EXPECT_EQ(cpu.delayTimer(), 1);
+    EXPECT_EQ(cpu.program_counter, 0x206);
+
+    // The polling loop only exits once enough frames have elapsed, however many cycles run per frame
+    cpu.runFrame(99);
+    EXPECT_EQ(cpu.program_counter, 0x206);
+    cpu.runFrame(99);
+    EXPECT_EQ(cpu.program_counter, 0x20A);
+}
+
+TYPED_TEST(CPUTest, skipIfKeyPressed)
+{
+    MockMemory memory;
+    TypeParam cpu {&memory};
+
+    cpu.gp_regs[0x1] = 0xA;
+    cpu.inst = {0xE1, 0x9E};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x200);
+    cpu.inst = {0xE1, 0xA1};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x202);
+
+    cpu.keypad = 1 << 0xA;
+    cpu.inst = {0xE1, 0x9E};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x204);
+    cpu.inst = {0xE1, 0xA1};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x204);
+}
+
+TYPED_TEST(CPUTest, waitForKey)
+{
+    MockMemory memory;
+    TypeParam cpu {&memory};
+
+    cpu.program_counter = 0x202;
+    cpu.inst = {0xF3, 0x0A};
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x200);
+
+    cpu.program_counter = 0x202;
+    cpu.keypad = (1 << 0x5) | (1 << 0xC);
+    cpu.decode();
+    EXPECT_EQ(cpu.program_counter, 0x202);
+    EXPECT_EQ(cpu.gp_regs[0x3], 0x5);
+}
+
+TEST(InputRecording, SaveLoadAndPlayback)
+{
+    InputRecording recording;
+    recording.seed = 42;
+    recording.cycles_per_frame = 12;
+    recording.rom_hash = 0x1234;
+    recording.record(0, 0);
+    recording.record(3, 0x10);
+    recording.record(4, 0x10);
+    recording.record(9, 0);
+    recording.frame_count = 12;
+    ASSERT_EQ(recording.inputEvents().size(), 2);
+
+    const std::string path {testing::TempDir() + "chip8_recording.bin"};
+    ASSERT_TRUE(recording.save(path));
+
+    InputRecording loaded;
+    ASSERT_TRUE(loaded.load(path));
+    std::remove(path.c_str());
+
+    EXPECT_EQ(loaded.seed, 42);
+    EXPECT_EQ(loaded.cycles_per_frame, 12);
+    EXPECT_EQ(loaded.rom_hash, 0x1234);
+    EXPECT_EQ(loaded.frame_count, 12);
+    EXPECT_EQ(loaded.keypadAt(0), 0);
+    EXPECT_EQ(loaded.keypadAt(3), 0x10);
+    EXPECT_EQ(loaded.keypadAt(8), 0x10);
+    EXPECT_EQ(loaded.keypadAt(9), 0);
+}
+
+TEST(InputRecording, ReplayIsBitExact)
+{
+    // Waits for a key, then keeps drawing random sprites
+    const std::vector<uint8_t> program {
+        0xF0, 0x0A, // V0 = key
+        0xC1, 0x3F, // V1 = random & 0x3F
+        0xC2, 0x1F, // V2 = random & 0x1F
+        0xA0, 0x50, // I = font
+        0xD1, 0x25, // draw at V1, V2
+        0x12, 0x02  // jump to 0x202
+    };
+
+    const auto run = [&program](InputRecording& input)
+    {
+        Memory memory;
+        memory.loadProgram(program);
+        CosmacCPU cpu {&memory};
+        cpu.seed(input.seed);
+
+        for (uint64_t frame{0}; frame < input.frame_count; ++frame)
+        {
+            cpu.keypad = input.keypadAt(frame);
+            cpu.runFrame(input.cycles_per_frame);
+        }
+
+        return cpu.display.rows();
+    };
+
+    InputRecording recording;
+    recording.seed = 7;
+    recording.cycles_per_frame = 10;
+    recording.frame_count = 50;
+    recording.record(20, 0x2);
+    recording.record(21, 0);
+
+    InputRecording replay {recording};
+    const auto first {run(recording)};
+    EXPECT_EQ(first, run(replay));
+    EXPECT_NE(first, display_t{});
+}
+
+TEST(MachineState, CallStack)
+{
+    CallStack stack;
+    EXPECT_TRUE(stack.empty());
+
+    for (int i{0}; i < 17; ++i)
+    {
+        stack.push(0x200 + i * 2);
+    }
+    EXPECT_EQ(stack.size(), 16);
+    EXPECT_EQ(stack.top(), 0x21E);
+
+    stack.pop();
+    EXPECT_EQ(stack.top(), 0x21C);
+}
+
+TEST(MachineState, SaveAndRestore)
+{
+    const std::vector<uint8_t> program {
+        0xC0, 0xFF, // V0 = random
+        0xA0, 0x50, // I = font '0'
+        0xD1, 0x25, // draw at V1, V2
+        0x71, 0x05, // V1 += 5
+        0x22, 0x0C, // call 0x20C
+        0x12, 0x00, // jump to 0x200
+        0xF0, 0x33, // store BCD of V0
+        0x00, 0xEE  // return
+    };
+
+    Memory memory;
+    memory.loadProgram(program);
+    CosmacCPU cpu {&memory};
+    cpu.seed(3);
+    cpu.runFrame(37);
+
+    MachineState state {};
+    cpu.saveState(state);
+
+    cpu.runFrame(50);
+    const display_t expected {cpu.display.rows()};
+    const int expected_pc {cpu.program_counter};
+
+    Memory other_memory;
+    CosmacCPU other {&other_memory};
+    other.loadState(state);
+    EXPECT_EQ(other.cpu_stack, state.cpu.cpu_stack);
+    EXPECT_EQ(state.ram_size, memory::SIZE);
+    EXPECT_TRUE(std::equal(other_memory.data().begin(), other_memory.data().end(), state.ram.begin()));
+
+    other.runFrame(50);
+    EXPECT_EQ(other.display.rows(), expected);
+    EXPECT_EQ(other.program_counter, expected_pc);
+}
+
+TEST(MachineState, SnapshotFile)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{0x60, 0x2A, 0xF0, 0x15, 0x22, 0x00});
+    CosmacCPU cpu {&memory};
+    cpu.seed(11);
+    cpu.keypad = 0x8001;
+    cpu.runFrame(6);
+    cpu.display.drawSpriteRow(60, 31, 0xFF);
+
+    MachineState state {};
+    cpu.saveState(state);
+
+    const std::string path {testing::TempDir() + "chip8_snapshot.bin"};
+    ASSERT_TRUE(saveSnapshot(path, state));
+
+    MachineState loaded {};
+    ASSERT_TRUE(loadSnapshot(path, loaded));
+    std::remove(path.c_str());
+
+    EXPECT_EQ(loaded.cpu.gp_regs, state.cpu.gp_regs);
+    EXPECT_EQ(loaded.cpu.program_counter, state.cpu.program_counter);
+    EXPECT_EQ(loaded.cpu.cpu_stack, state.cpu.cpu_stack);
+    EXPECT_EQ(loaded.cpu.delay_timer, state.cpu.delay_timer);
+    EXPECT_EQ(loaded.cpu.keypad, 0x8001);
+    EXPECT_EQ(loaded.cpu.rng.state, state.cpu.rng.state);
+    EXPECT_EQ(loaded.ram, state.ram);
+    EXPECT_EQ(loaded.framebuffer, state.framebuffer);
+
+    EXPECT_FALSE(loadSnapshot(path, loaded));
+
+    // High resolution and plane selection survive the round trip
+    cpu.display.setHires(true);
+    cpu.display.selectPlanes(3);
+    cpu.display.drawSpriteRow(1, 100, 50, 0xFFFF);
+    cpu.saveState(state);
+    ASSERT_TRUE(saveSnapshot(path, state));
+    ASSERT_TRUE(loadSnapshot(path, loaded));
+    std::remove(path.c_str());
+    EXPECT_TRUE(loaded.framebuffer.hires);
+    EXPECT_EQ(loaded.framebuffer, state.framebuffer);
+}
+
+namespace
+{
+    // Draws random sprites forever, so every frame changes RAM, registers and the framebuffer
+    const std::vector<uint8_t> REWIND_PROGRAM {
+        0xC1, 0x3F, // V1 = random & 0x3F
+        0xC2, 0x1F, // V2 = random & 0x1F
+        0xA0, 0x50, // I = font
+        0xD1, 0x25, // draw at V1, V2
+        0xA3, 0x00, // I = 0x300
+        0xF1, 0x33, // store BCD of V1
+        0x12, 0x00  // jump to 0x200
+    };
+}
+
+TEST(RewindBuffer, SeekRebuildsEveryFrame)
+{
+    Memory memory;
+    memory.loadProgram(REWIND_PROGRAM);
+    CosmacCPU cpu {&memory};
+    cpu.seed(5);
+
+    RewindBuffer buffer {history::DEFAULT_CAPACITY, 8};
+    std::vector<MachineState> expected(50);
+
+    for (uint64_t frame{0}; frame < expected.size(); ++frame)
+    {
+        cpu.saveState(expected[frame]);
+        buffer.push(frame, expected[frame]);
+        cpu.runFrame(7);
+    }
+
+    EXPECT_EQ(buffer.size(), 50);
+    EXPECT_LT(buffer.bytesPerFrame(), (sizeof(CpuState) + sizeof(Framebuffer) + memory::SIZE) / 4);
+
+    for (const uint64_t frame : {0, 1, 7, 8, 9, 23, 49})
+    {
+        MachineState state {};
+        ASSERT_TRUE(buffer.seek(frame, state));
+        EXPECT_EQ(state.cpu.program_counter, expected[frame].cpu.program_counter) << "frame " << frame;
+        EXPECT_EQ(state.cpu.gp_regs, expected[frame].cpu.gp_regs) << "frame " << frame;
+        EXPECT_EQ(state.cpu.rng.state, expected[frame].cpu.rng.state) << "frame " << frame;
+        EXPECT_EQ(state.ram, expected[frame].ram) << "frame " << frame;
+        EXPECT_EQ(state.framebuffer, expected[frame].framebuffer) << "frame " << frame;
+    }
+}
+
+TEST(RewindBuffer, NewMemorySizeStartsOver)
+{
+    Memory memory;
+    memory.loadProgram(REWIND_PROGRAM);
+    CosmacCPU cpu {&memory};
+
+    Memory xo_memory {memorySize(Profile::xoChip)};
+    xo_memory.loadProgram(REWIND_PROGRAM);
+    XoChipCPU xo {&xo_memory};
+
+    RewindBuffer buffer {history::DEFAULT_CAPACITY, 8};
+    MachineState state {};
+    for (uint64_t frame{0}; frame < 10; ++frame)
+    {
+        cpu.saveState(state);
+        buffer.push(frame, state);
+        cpu.runFrame(7);
+    }
+
+    MachineState expected {};
+    for (uint64_t frame{10}; frame < 20; ++frame)
+    {
+        xo.runFrame(7);
+        xo.saveState(state);
+        buffer.push(frame, state);
+        if (frame == 15)
+            expected = state;
+    }
+
+    EXPECT_EQ(buffer.size(), 10);
+    EXPECT_FALSE(buffer.seek(5, state));
+    ASSERT_TRUE(buffer.seek(15, state));
+    EXPECT_EQ(state.ram_size, memory::XO_CHIP_SIZE);
+    EXPECT_EQ(state.ram, expected.ram);
+    EXPECT_EQ(state.cpu, expected.cpu);
+}
+
+TEST(RewindBuffer, PaddingStaysOutOfDeltas)
+{
+    Memory memory;
+    memory.loadProgram(REWIND_PROGRAM);
+    CosmacCPU cpu {&memory};
+    cpu.runFrame(7);
+
+    // The same machine twice, the second with every padding byte set
+    auto clean {std::make_unique<MachineState>()};
+    cpu.saveState(*clean);
+    auto dirty {std::make_unique<MachineState>()};
+    std::memset(static_cast<void*>(dirty.get()), 0xAA, sizeof(MachineState));
+    dirty->cpu.gp_regs = clean->cpu.gp_regs;
+    dirty->cpu.program_counter = clean->cpu.program_counter;
+    dirty->cpu.index_reg = clean->cpu.index_reg;
+    dirty->cpu.cpu_stack.entries = clean->cpu.cpu_stack.entries;
+    dirty->cpu.cpu_stack.depth = clean->cpu.cpu_stack.depth;
+    dirty->cpu.delay_timer = clean->cpu.delay_timer;
+    dirty->cpu.sound_timer = clean->cpu.sound_timer;
+    dirty->cpu.keypad = clean->cpu.keypad;
+    dirty->cpu.rng.state = clean->cpu.rng.state;
+    dirty->framebuffer.planes = clean->framebuffer.planes;
+    dirty->framebuffer.hires = clean->framebuffer.hires;
+    dirty->framebuffer.plane_mask = clean->framebuffer.plane_mask;
+    dirty->ram_size = clean->ram_size;
+    dirty->ram = clean->ram;
+    ASSERT_NE(std::memcmp(clean.get(), dirty.get(), sizeof(MachineState)), 0);
+
+    RewindBuffer clean_buffer {};
+    RewindBuffer dirty_buffer {};
+    clean_buffer.push(0, *clean);
+    dirty_buffer.push(0, *dirty);
+    EXPECT_EQ(clean_buffer.storedBytes(), dirty_buffer.storedBytes());
+
+    MachineState restored {};
+    ASSERT_TRUE(dirty_buffer.seek(0, restored));
+    EXPECT_EQ(restored.cpu, clean->cpu);
+    EXPECT_EQ(restored.framebuffer, clean->framebuffer);
+}
+
+TEST(RewindBuffer, EvictsOldestKeyframeGroup)
+{
+    Memory memory;
+    memory.loadProgram(REWIND_PROGRAM);
+    CosmacCPU cpu {&memory};
+
+    RewindBuffer buffer {4096, 10};
+    MachineState state {};
+
+    for (uint64_t frame{0}; frame < 200; ++frame)
+    {
+        cpu.saveState(state);
+        buffer.push(frame, state);
+        cpu.runFrame(7);
+    }
+
+    EXPECT_LE(buffer.storedBytes(), 4096);
+    EXPECT_GT(buffer.oldestFrame(), 0);
+    EXPECT_EQ(buffer.newestFrame(), 199);
+    EXPECT_FALSE(buffer.seek(buffer.oldestFrame() - 1, state));
+    EXPECT_TRUE(buffer.seek(buffer.oldestFrame(), state));
+}
+
+TEST(RewindBuffer, RewindAndResume)
+{
+    Memory memory;
+    memory.loadProgram(REWIND_PROGRAM);
+    CosmacCPU cpu {&memory};
+    cpu.seed(9);
+
+    RewindBuffer buffer {history::DEFAULT_CAPACITY, 4};
+    MachineState state {};
+
+    for (uint64_t frame{0}; frame < 30; ++frame)
+    {
+        cpu.saveState(state);
+        buffer.push(frame, state);
+        cpu.runFrame(7);
+    }
+    const display_t at_thirty {cpu.display.rows()};
+
+    ASSERT_TRUE(buffer.rewindTo(10, state));
+    EXPECT_EQ(buffer.newestFrame(), 10);
+    cpu.loadState(state);
+
+    // Re-running from the rewound frame reaches the same machine again
+    cpu.runFrame(7);
+    for (uint64_t frame{11}; frame < 30; ++frame)
+    {
+        cpu.saveState(state);
+        buffer.push(frame, state);
+        cpu.runFrame(7);
+    }
+
+    EXPECT_EQ(cpu.display.rows(), at_thirty);
+    ASSERT_TRUE(buffer.seek(29, state));
+    cpu.loadState(state);
+    cpu.runFrame(7);
+    EXPECT_EQ(cpu.display.rows(), at_thirty);
+}
+
+TEST(ExecutionProfile, CountsAndJson)
+{
+    ExecutionProfile profile;
+    profile.countInstruction(0x200, Opcode::setRegister);
+    profile.countInstruction(0x202, Opcode::drawOnDisplay);
+    profile.countInstruction(0x202, Opcode::drawOnDisplay);
+    profile.endFrame();
+    profile.countInstruction(0x200, Opcode::setRegister);
+    profile.endFrame();
+
+    EXPECT_EQ(profile.opcodeCount(Opcode::drawOnDisplay), 2);
+    EXPECT_EQ(profile.addressCount(0x200), 2);
+    EXPECT_EQ(profile.frameCount(), 2);
+    EXPECT_EQ(profile.maxCyclesPerFrame(), 3);
+    EXPECT_EQ(profile.maxDrawsPerFrame(), 2);
+
+    std::ostringstream json;
+    profile.writeJson(json);
+    EXPECT_NE(json.str().find("\"drawOnDisplay\": 2"), std::string::npos);
+    EXPECT_NE(json.str().find("\"cycles_per_frame\": {\"mean\": 2, \"max\": 3}"), std::string::npos);
+    EXPECT_NE(json.str().find("{\"address\": 512, \"count\": 2}"), std::string::npos);
+}
+
+TEST(ExecutionProfile, CountsEveryBackend)
+{
+#ifndef CHIP8_INSTRUMENTATION
+    static_assert(std::is_empty_v<profile_t>);
+    GTEST_SKIP() << "built without CHIP8_INSTRUMENTATION";
+#else
+    {
+        for (const Backend backend : {Backend::interpreter, Backend::blockCache})
+        {
+            Memory memory;
+            memory.loadProgram(std::vector<uint8_t>{
+                0x60, 0x01, // V0 = 1
+                0xD0, 0x01, // draw at V0, V0
+                0x12, 0x00  // jump to 0x200
+            });
+            CosmacCPU cpu {&memory};
+            cpu.backend = backend;
+
+            // Drawing the blank sprite at 0x000 changes nothing, the loop would be elided uncounted
+            cpu.skip_idle_loops = false;
+            cpu.runFrame(9);
+            cpu.runFrame(6);
+
+            EXPECT_EQ(cpu.profile.opcodeCount(Opcode::drawOnDisplay), 5);
+            EXPECT_EQ(cpu.profile.addressCount(0x204), 5);
+            EXPECT_EQ(cpu.profile.frameCount(), 2);
+            EXPECT_EQ(cpu.profile.maxCyclesPerFrame(), 9);
+            EXPECT_EQ(cpu.profile.maxDrawsPerFrame(), 3);
+        }
+    }
+#endif
+}
+
+TEST(CallGraphSampler, FoldedStacks)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x22, 0x06, // 200: call 0x206
+        0x12, 0x00, // 202: jump to 0x200
+        0x00, 0x00, // 204: padding
+        0x70, 0x01, // 206: V0 += 1
+        0x22, 0x0E, // 208: call 0x20E
+        0x00, 0xEE, // 20A: return
+        0x00, 0x00, // 20C: padding
+        0x71, 0x01, // 20E: V1 += 1
+        0x71, 0x01, // 210: V1 += 1
+        0x00, 0xEE  // 212: return
+    });
+    CosmacCPU cpu {&memory};
+
+    // Every instruction sampled, one loop iteration runs 2 in main, 3 in each subroutine
+    CallGraphSampler sampler {&memory, 1};
+    sampler.execute(cpu, 80);
+    EXPECT_EQ(sampler.sampleCount(), 80);
+
+    std::ostringstream folded;
+    sampler.writeFolded(folded);
+    EXPECT_EQ(folded.str(),
+              "main 20\n"
+              "main;sub_0x206 30\n"
+              "main;sub_0x206;sub_0x20E 30\n");
+}
+
+TEST(TraceRecorder, RecordsAndReadsBack)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x05, // V0 = 5
+        0x61, 0xFF, // V1 = 0xFF
+        0x81, 0x04, // V1 += V0, carry
+        0xA2, 0x34, // I = 0x234
+        0x12, 0x00  // jump to 0x200
+    });
+    CosmacCPU cpu {&memory};
+
+    const std::string path {testing::TempDir() + "chip8_trace.bin"};
+    {
+        // A ring smaller than the run, so the producer has to wait for the writer
+        TraceRecorder recorder {path, 16};
+        ASSERT_TRUE(recorder.isOpen());
+        cpu.tracer = &recorder.addStream();
+        recorder.start();
+        cpu.execute(1000);
+        recorder.stop();
+        EXPECT_EQ(recorder.recordsWritten(), 1000);
+    }
+
+    TraceReader reader {path};
+    ASSERT_TRUE(reader.isValid());
+
+    std::vector<TraceRecord> records;
+    uint32_t stream {};
+    TraceRecord record {};
+    while (reader.next(stream, record))
+    {
+        EXPECT_EQ(stream, 0);
+        records.push_back(record);
+    }
+    std::remove(path.c_str());
+
+    ASSERT_EQ(records.size(), 1000);
+    EXPECT_EQ(records[0], (TraceRecord{0x200, 0x6005, 0x000, 0x0, 0x05}));
+    EXPECT_EQ(records[2], (TraceRecord{0x204, 0x8104, 0x000, 0x1 | trace::FLAG_CHANGED, 0x04}));
+    EXPECT_EQ(records[3], (TraceRecord{0x206, 0xA234, 0x234, trace::NO_REGISTER, 0x00}));
+    EXPECT_EQ(records[999].pc, 0x208);
+}
+
+TEST(Recompiler, ControlFlowGraph)
+{
+    const std::vector<uint8_t> rom {
+        0x6A, 0x00, // 0x200: VA = 0
+        0x22, 0x0E, // 0x202: call 0x20E
+        0x7A, 0x01, // 0x204: VA += 1
+        0x3A, 0x05, // 0x206: skip if VA == 5
+        0x12, 0x02, // 0x208: jump to 0x202
+        0xB2, 0x14, // 0x20A: jump to 0x214 + V0
+        0xF0, 0x00, // 0x20C: never reached, data
+        0x85, 0xA0, // 0x20E: V5 = VA
+        0x00, 0xEE  // 0x210: return
+    };
+
+    const Recompiler recompiler {rom};
+    const auto& blocks {recompiler.recoveredBlocks()};
+
+    std::vector<int> starts;
+    for (const auto& [start, block] : blocks)
+    {
+        starts.push_back(start);
+    }
+
+    // The backward jump splits the entry block, BNNN is left to the interpreter and its target is unknown
+    EXPECT_EQ(starts, (std::vector<int>{0x200, 0x202, 0x204, 0x208, 0x20E}));
+    EXPECT_EQ(blocks.at(0x202).successors, (std::vector<int>{0x20E, 0x204}));
+    EXPECT_EQ(blocks.at(0x204).successors, (std::vector<int>{0x208, 0x20A}));
+    EXPECT_TRUE(blocks.at(0x20E).successors.empty());
+    EXPECT_EQ(recompiler.instructionCount(), 7);
+
+    std::ostringstream out;
+    recompiler.emit(out, "test.ch8");
+    EXPECT_NE(out.str().find("int block_020E(CPU& cpu"), std::string::npos);
+    EXPECT_EQ(out.str().find("block_020A"), std::string::npos);
+}
+
+TEST(Display, IncrementalHash)
+{
+    Display display;
+    const uint64_t blank {display.hash()};
+    EXPECT_EQ(blank, Display::hashOf(display.state()));
+
+    display.drawSpriteRow(0, 60, 3, 0xFF00);
+    display.selectPlanes(0x3);
+    display.drawSpriteRow(1, 10, 7, 0x8001);
+    display.scrollDown(2);
+    EXPECT_NE(display.hash(), blank);
+    EXPECT_EQ(display.hash(), Display::hashOf(display.state()));
+
+    // The same pixels reached another way hash the same
+    Display other;
+    other.restore(display.state());
+    EXPECT_EQ(other.hash(), display.hash());
+
+    // Drawing a sprite twice puts every word back
+    const uint64_t before {display.hash()};
+    display.drawSpriteRow(0, 33, 20, 0x1234);
+    EXPECT_NE(display.hash(), before);
+    display.drawSpriteRow(0, 33, 20, 0x1234);
+    EXPECT_EQ(display.hash(), before);
+
+    // The same pixel in another plane or another word is a different image
+    Display plane_0;
+    Display plane_1;
+    plane_1.selectPlanes(0x2);
+    plane_0.set(5, 5, Pixel::on);
+    plane_1.set(5, 5, Pixel::on);
+    EXPECT_NE(plane_0.hash(), plane_1.hash());
+
+    display.setHires(true);
+    EXPECT_NE(display.hash(), blank);
+    EXPECT_EQ(display.hash(), Display::hashOf(display.state()));
+    display.clear();
+    display.setHires(false);
+    EXPECT_EQ(display.hash(), blank);
+}
+
+TEST(GoldenRecording, SaveLoadAndVerify)
+{
+    GoldenRecording golden;
+    golden.profile = 2;
+    golden.seed = 9;
+    golden.cycles_per_frame = 15;
+    golden.rom_hash = 0x5678;
+    golden.frame_count = 10;
+    golden.record(0, 0xA);
+    golden.record(1, 0xA);
+    golden.record(2, 0xB);
+    golden.record(7, 0xA);
+    ASSERT_EQ(golden.hashChanges().size(), 3);
+
+    const std::string path {testing::TempDir() + "chip8_golden.bin"};
+    ASSERT_TRUE(golden.save(path));
+
+    GoldenRecording loaded;
+    ASSERT_TRUE(loaded.load(path));
+    std::remove(path.c_str());
+
+    EXPECT_EQ(loaded.profile, 2);
+    EXPECT_EQ(loaded.seed, 9);
+    EXPECT_EQ(loaded.cycles_per_frame, 15);
+    EXPECT_EQ(loaded.rom_hash, 0x5678);
+    EXPECT_EQ(loaded.frame_count, 10);
+    EXPECT_EQ(loaded.hashAt(0), 0xA);
+    EXPECT_EQ(loaded.hashAt(1), 0xA);
+    EXPECT_EQ(loaded.nextChangeFrame(), 2);
+    EXPECT_EQ(loaded.hashAt(6), 0xB);
+    EXPECT_EQ(loaded.nextChangeFrame(), 7);
+    EXPECT_EQ(loaded.hashAt(9), 0xA);
+    EXPECT_EQ(loaded.nextChangeFrame(), UINT64_MAX);
+}
+
+TEST(Protocol, DecodesChangedRows)
+{
+    Display display;
+    display.drawSpriteRow(0, 3, 4, 0xF000);
+    display.selectPlanes(0x2);
+    display.drawSpriteRow(1, 40, 20, 0x0F00);
+
+    std::vector<uint8_t> stream;
+    protocol::appendHello(stream);
+    protocol::appendFrame(stream, 0, protocol::FLAG_SOUND, Framebuffer{}, protocol::ALL_ROWS);
+    const std::size_t full_size {stream.size()};
+    protocol::appendFrame(stream, 5, protocol::FLAG_SOUND, display.state(), display.takeDirtyRows());
+
+    // Only rows 4 and 20 follow the header
+    EXPECT_EQ(stream.size() - full_size, protocol::FRAME_HEADER_SIZE + 2 * protocol::ROW_SIZE);
+
+    // Fed a byte at a time, as a slow socket might deliver it
+    FrameDecoder decoder;
+    for (const uint8_t byte : stream)
+    {
+        ASSERT_TRUE(decoder.feed(std::span<const uint8_t>{&byte, 1}));
+    }
+    EXPECT_TRUE(decoder.greeted);
+    EXPECT_EQ(decoder.frames_received, 2);
+    EXPECT_EQ(decoder.frame, 5);
+    EXPECT_EQ(decoder.flags, protocol::FLAG_SOUND);
+    EXPECT_EQ(decoder.framebuffer.planes, display.state().planes);
+
+    const std::vector<uint8_t> garbage {0x7F};
+    EXPECT_FALSE(decoder.feed(garbage));
+}
+
+#ifdef __linux__
+namespace
+{
+    int connectClient(const std::string& path)
+    {
+        const int fd {socket(AF_UNIX, SOCK_STREAM, 0)};
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), address.sun_path);
+
+        const timeval timeout {2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        EXPECT_EQ(connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+        return fd;
+    }
+
+    // Reads until the condition holds or the server goes quiet
+    template <typename Done>
+    bool receiveUntil(int fd, FrameDecoder& decoder, Done done)
+    {
+        uint8_t buffer[4096];
+        while (!done())
+        {
+            const ssize_t received {recv(fd, buffer, sizeof(buffer), 0)};
+            if (received <= 0 || !decoder.feed(std::span<const uint8_t>{buffer, static_cast<std::size_t>(received)}))
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST(Server, StreamsFramesAndTakesKeypad)
+{
+    // Draws a 0 as far across as the number of the first key pressed, then idles
+    const std::vector<uint8_t> rom {
+        0xF0, 0x0A, // V0 = key
+        0xA0, 0x50, // I = font
+        0xD0, 0x15, // draw at V0, V1
+        0x12, 0x06  // jump to 0x206
+    };
+
+    Memory reference_memory;
+    reference_memory.loadProgram(rom);
+    CosmacCPU reference {&reference_memory};
+    reference.keypad = 1 << 0x7;
+    reference.runFrame(timer::CYCLES_PER_FRAME);
+
+    const std::string path {testing::TempDir() + "chip8_server.sock"};
+    Server server {rom, ServerOptions{}};
+    ASSERT_TRUE(server.listenUnix(path));
+    std::thread serving {&Server::run, &server};
+
+    const int first {connectClient(path)};
+    const int second {connectClient(path)};
+
+    // Asserts return from here, so the server is always stopped and joined
+    [&]
+    {
+        FrameDecoder first_view;
+        FrameDecoder second_view;
+
+        // A blank screen in full first
+        ASSERT_TRUE(receiveUntil(first, first_view, [&] { return first_view.frames_received > 0; }));
+        EXPECT_TRUE(first_view.greeted);
+        EXPECT_EQ(first_view.framebuffer.planes, display_t{});
+
+        std::vector<uint8_t> keypad;
+        protocol::appendKeypad(keypad, 1 << 0x7);
+        ASSERT_EQ(send(first, keypad.data(), keypad.size(), 0), static_cast<ssize_t>(keypad.size()));
+        ASSERT_TRUE(receiveUntil(first, first_view, [&] { return first_view.framebuffer.planes != display_t{}; }));
+        EXPECT_EQ(first_view.framebuffer.planes, reference.display.rows());
+
+        // The other session has its own machine, still waiting for a key
+        ASSERT_TRUE(receiveUntil(second, second_view, [&] { return second_view.frames_received > 0; }));
+        EXPECT_EQ(second_view.framebuffer.planes, display_t{});
+    }();
+
+    close(first);
+    close(second);
+    server.stop();
+    serving.join();
+    EXPECT_GT(server.bytesSent(), 0);
+}
+
+TEST(Server, DelayWaitKeepsStreaming)
+{
+    // Flips a sprite every time the delay timer set to 1 runs out
+    const std::vector<uint8_t> rom {
+        0x61, 0x01, // 0x200: V1 = 1
+        0xA0, 0x50, // 0x202: I = font
+        0xD0, 0x05, // 0x204: draw at V0, V0
+        0xF1, 0x15, // 0x206: DT = V1
+        0xF2, 0x07, // 0x208: V2 = DT
+        0x32, 0x00, // 0x20A: skip if V2 == 0
+        0x12, 0x08, // 0x20C: jump to 0x208
+        0x12, 0x04  // 0x20E: jump to 0x204
+    };
+
+    const std::string path {testing::TempDir() + "chip8_server_delay.sock"};
+    Server server {rom, ServerOptions{}};
+    ASSERT_TRUE(server.listenUnix(path));
+    std::thread serving {&Server::run, &server};
+
+    const int client {connectClient(path)};
+
+    // Every flip is a frame with changed rows, a session frozen in the wait would send none
+    [&]
+    {
+        FrameDecoder view;
+        uint64_t seen {1};
+        int blank {0};
+        int drawn {0};
+        ASSERT_TRUE(receiveUntil(client, view, [&]
+        {
+            if (view.frames_received > seen)
+            {
+                (view.framebuffer.planes == display_t{} ? blank : drawn)++;
+                seen = view.frames_received;
+            }
+            return blank >= 3 && drawn >= 3;
+        }));
+    }();
+
+    close(client);
+    server.stop();
+    serving.join();
+}
+#endif
+
+TEST(FrameCapture, DeltaRoundTrip)
+{
+    const std::string path {testing::TempDir() + "chip8_capture.c8v"};
+    Display display;
+    std::vector<CapturedFrame> expected;
+
+    {
+        FrameCapture capture {path, CaptureFormat::delta};
+        ASSERT_TRUE(capture.isOpen());
+        capture.start();
+
+        for (uint64_t frame{0}; frame < 40; ++frame)
+        {
+            // Changes every third frame, switching to high resolution half way through
+            if (frame == 20)
+                display.setHires(true);
+            if (frame % 3 == 0)
+                display.drawSpriteRow(static_cast<int>(frame % 2), static_cast<int>(frame * 3), static_cast<int>(frame), 0xF0F0);
+
+            if (frame == 0 || frame % 3 == 0 || frame == 20)
+                expected.push_back({frame, display.state()});
+            capture.capture(frame, display);
+        }
+
+        capture.stop();
+        EXPECT_EQ(capture.framesWritten(), expected.size());
+        EXPECT_EQ(capture.droppedFrames(), 0);
+    }
+
+    CaptureReader reader {path};
+    ASSERT_TRUE(reader.isValid());
+
+    uint64_t frame {};
+    Framebuffer framebuffer {};
+    for (const CapturedFrame& captured : expected)
+    {
+        ASSERT_TRUE(reader.next(frame, framebuffer));
+        EXPECT_EQ(frame, captured.frame);
+        EXPECT_EQ(framebuffer.planes, captured.framebuffer.planes) << frame;
+        EXPECT_EQ(framebuffer.hires, captured.framebuffer.hires) << frame;
+    }
+    EXPECT_FALSE(reader.next(frame, framebuffer));
+    EXPECT_TRUE(reader.isComplete());
+    EXPECT_EQ(reader.frameCount(), 40);
+    std::remove(path.c_str());
+}
+
+TEST(FrameCapture, Y4mHasEveryFrame)
+{
+    const std::string path {testing::TempDir() + "chip8_capture.y4m"};
+    Display display;
+    display.set(0, 0, Pixel::on);
+
+    {
+        FrameCapture capture {path, CaptureFormat::y4m};
+        capture.start();
+        for (uint64_t frame{0}; frame < 25; ++frame)
+        {
+            capture.capture(frame, display);
+        }
+        capture.stop();
+        EXPECT_EQ(capture.framesWritten(), 1);
+    }
+
+    std::ifstream file {path, std::ios::binary};
+    std::string header;
+    std::getline(file, header);
+    EXPECT_EQ(header, "YUV4MPEG2 W128 H64 F60:1 Ip A1:1 C444");
+
+    // A lit low resolution pixel covers 2x2 video pixels
+    std::string frame_header;
+    std::getline(file, frame_header);
+    std::string luma(capture::WIDTH * capture::HEIGHT, '\0');
+    file.read(luma.data(), static_cast<std::streamsize>(luma.size()));
+    EXPECT_EQ(luma[0], luma[capture::WIDTH + 1]);
+    EXPECT_NE(luma[0], luma[2]);
+
+    file.seekg(0, std::ios::end);
+    const std::size_t frame_size {6 + 3 * capture::WIDTH * capture::HEIGHT};
+    EXPECT_EQ(static_cast<std::size_t>(file.tellg()), header.size() + 1 + 25 * frame_size);
+    file.close();
+    std::remove(path.c_str());
+}
+
+TEST(FrameCapture, DropsRatherThanStalls)
+{
+    const std::string path {testing::TempDir() + "chip8_capture_full.c8v"};
+    Display display;
+
+    // Never started, so the queue fills and every further change is dropped at once
+    FrameCapture capture {path, CaptureFormat::delta, 4};
+    for (uint64_t frame{0}; frame < 10; ++frame)
+    {
+        display.set(static_cast<int>(frame), 0, Pixel::on);
+        capture.capture(frame, display);
+    }
+    EXPECT_EQ(capture.droppedFrames(), 6);
+
+    // The last change is still written, by the first frame that finds room once the writer runs
+    capture.start();
+    uint64_t last_frame {10};
+    for (uint64_t dropped {capture.droppedFrames()}; ; dropped = capture.droppedFrames(), ++last_frame)
+    {
+        capture.capture(last_frame, display);
+        if (capture.droppedFrames() == dropped)
+            break;
+        std::this_thread::yield();
+    }
+    capture.stop();
+    EXPECT_EQ(capture.framesWritten(), 5);
+
+    CaptureReader reader {path};
+    uint64_t frame {};
+    Framebuffer framebuffer {};
+    while (reader.next(frame, framebuffer))
+    {
+    }
+    EXPECT_EQ(frame, last_frame);
+    EXPECT_EQ(framebuffer.planes, display.state().planes);
+    std::remove(path.c_str());
+}
+
+TEST(IdleLoop, JumpToSelf)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x05, // V0 = 5
+        0x12, 0x02  // jump to 0x202
+    });
+    CosmacCPU cpu {&memory};
+
+    cpu.runFrame(1000);
+    EXPECT_EQ(cpu.program_counter, 0x202);
+    EXPECT_EQ(cpu.elidedCycles(), 998);
+    ASSERT_TRUE(cpu.isHalted());
+
+    cpu.skipHaltedFrames(100, 1000);
+    EXPECT_EQ(cpu.program_counter, 0x202);
+    EXPECT_EQ(cpu.elidedCycles(), 100'998);
+
+    cpu.skip_idle_loops = false;
+    cpu.runFrame(1000);
+    EXPECT_EQ(cpu.elidedCycles(), 100'998);
+    EXPECT_FALSE(cpu.isHalted());
+}
+
+TEST(IdleLoop, PollingLoopMatchesInterpreter)
+{
+    // Waits on the delay timer, then bumps V0 and waits again
+    const std::vector<uint8_t> program {
+        0x60, 0x03, // 0x200: V0 = 3
+        0xF0, 0x15, // 0x202: DT = V0
+        0xF1, 0x07, // 0x204: V1 = DT
+        0x31, 0x00, // 0x206: skip if V1 == 0
+        0x12, 0x04, // 0x208: jump to 0x204
+        0x70, 0x01, // 0x20A: V0 += 1
+        0x12, 0x02  // 0x20C: jump to 0x202
+    };
+
+    for (const Backend backend : {Backend::interpreter, Backend::blockCache})
+    {
+        Memory reference_memory;
+        reference_memory.loadProgram(program);
+        CosmacCPU reference {&reference_memory};
+        reference.skip_idle_loops = false;
+
+        Memory memory;
+        memory.loadProgram(program);
+        CosmacCPU cpu {&memory};
+        cpu.backend = backend;
+
+        // 50 is no multiple of the three-instruction loop, so every slice ends part way through it
+        for (int frame{0}; frame < 40; ++frame)
+        {
+            reference.runFrame(50);
+            cpu.runFrame(50);
+            ASSERT_EQ(static_cast<const CpuState&>(cpu), static_cast<const CpuState&>(reference)) << frame;
+        }
+
+        EXPECT_GT(cpu.elidedCycles(), 1000);
+        EXPECT_EQ(reference.elidedCycles(), 0);
+    }
+}
+
+TEST(IdleLoop, SkipsHaltedFrames)
+{
+    const std::vector<uint8_t> program {
+        0x60, 0x07, // 0x200: V0 = 7
+        0xF1, 0x0A, // 0x202: V1 = key
+        0x71, 0x01, // 0x204: V1 += 1
+        0x12, 0x04  // 0x206: jump to 0x204
+    };
+
+    Memory reference_memory;
+    reference_memory.loadProgram(program);
+    CosmacCPU reference {&reference_memory};
+    reference.skip_idle_loops = false;
+
+    Memory memory;
+    memory.loadProgram(program);
+    CosmacCPU cpu {&memory};
+
+    for (int frame{0}; frame < 10; ++frame)
+    {
+        reference.runFrame(7);
+    }
+
+    cpu.runFrame(7);
+    ASSERT_TRUE(cpu.isHalted());
+    cpu.skipHaltedFrames(9, 7);
+    cpu.endFrame();
+    EXPECT_EQ(static_cast<const CpuState&>(cpu), static_cast<const CpuState&>(reference));
+    EXPECT_EQ(cpu.elidedCycles(), 68);
+
+    // A key press is the event that ends the halt
+    cpu.keypad = 1 << 0x3;
+    EXPECT_FALSE(cpu.isHalted());
+    cpu.runFrame(7);
+    EXPECT_EQ(cpu.gp_regs[0x1], 0x3 + 3);
+}
+
+TEST(IdleLoop, DelayWaitIsNotHalted)
+{
+    // Waits for the delay timer set to 1, a slice elided with DT at 1 must still see it reach 0
+    const std::vector<uint8_t> program {
+        0x60, 0x01, // 0x200: V0 = 1
+        0xF0, 0x15, // 0x202: DT = V0
+        0xF1, 0x07, // 0x204: V1 = DT
+        0x31, 0x00, // 0x206: skip if V1 == 0
+        0x12, 0x04, // 0x208: jump to 0x204
+        0x72, 0x01, // 0x20A: V2 += 1
+        0x12, 0x0A  // 0x20C: jump to 0x20A
+    };
+
+    Memory reference_memory;
+    reference_memory.loadProgram(program);
+    CosmacCPU reference {&reference_memory};
+    reference.skip_idle_loops = false;
+
+    Memory memory;
+    memory.loadProgram(program);
+    CosmacCPU cpu {&memory};
+
+    // Stepped the way the front ends step a frame
+    for (int frame{0}; frame < 10; ++frame)
+    {
+        reference.runFrame(12);
+        if (cpu.isHalted())
+        {
+            cpu.skipHaltedFrames(1, 12);
+            cpu.endFrame();
+        }
+        else
+            cpu.runFrame(12);
+        ASSERT_EQ(static_cast<const CpuState&>(cpu), static_cast<const CpuState&>(reference)) << frame;
+    }
+
+    EXPECT_GT(cpu.gp_regs[0x2], 0);
+}
+
+TEST(IdleLoop, RestoreClearsHalt)
+{
+    const std::vector<uint8_t> program {
+        0x60, 0x05, // 0x200: V0 = 5
+        0x70, 0x01, // 0x202: V0 += 1
+        0x12, 0x04  // 0x204: jump to 0x204
+    };
+
+    Memory memory;
+    memory.loadProgram(program);
+    CosmacCPU cpu {&memory};
+
+    MachineState start {};
+    cpu.saveState(start);
+    cpu.runFrame(10);
+    ASSERT_TRUE(cpu.isHalted());
+
+    // The restored machine is back at its first instruction and has to run it
+    cpu.loadState(start);
+    EXPECT_FALSE(cpu.isHalted());
+    cpu.runFrame(10);
+    EXPECT_EQ(cpu.gp_regs[0x0], 6);
+    EXPECT_EQ(cpu.program_counter, 0x204);
+}
+
+TEST(CPU, makeCPU)
+{
+    Memory memory;
+    memory.loadProgram(std::vector<uint8_t>{
+        0x60, 0x81, // V0 = 0x81
+        0x61, 0x02, // V1 = 2
+        0x80, 0x16  // V0 >>= 1, or V0 = V1 >> 1 on the COSMAC
+    });
+
+    Profile profile {};
+    EXPECT_FALSE(parseProfile("xo-chip", profile));
+
+    for (const auto& [name, expected] : {std::pair{"cosmac", 0x01}, std::pair{"chip48", 0x40}, std::pair{"superchip", 0x40}})
+    {
+        ASSERT_TRUE(parseProfile(name, profile));
+        const auto cpu {makeCPU(profile, &memory)};
+        cpu->execute(3);
+        EXPECT_EQ(cpu->gp_regs[0x0], expected) << name;
+    }
 }